@@ -2,48 +2,1158 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* Patterns shorter than this are found with memchr on their first */
+/* byte and a memcmp of the rest; longer ones with Two-Way */
+#define SHORT_PATTERN 4
+
+/* Patterns up to this long are found by comparing their first and */
+/* last bytes against 16 or 32 positions at once, and checked in */
+/* full only where both agree */
+#define FILTER_PATTERN 32
+
+/* A compiled pattern. The Two-Way fields follow Crochemore and */
+/* Perrin: the pattern splits at ms+1 into a left and right half, */
+/* p is the period used to shift after a full right-half match, and */
+/* shift[c] is one past the last position of byte c (0 if absent) */
+typedef struct searcher searcher;
+
+struct searcher {
+	const char* pat;
+	size_t m;
+	size_t ms, p, mem0;
+	size_t shift[256];
+};
+
+/* Streams are read this many bytes at a time */
+#define STREAM_BLOCK (1 << 20)
+
+/* Output pieces gathered for one writev, within POSIX's IOV_MAX */
+#define IOV_BATCH 1024
+
+/* Buffers are split across threads in chunks of at least this */
+#define MT_MIN_CHUNK (1 << 20)
+
+/* The start of every match, in order */
+typedef struct match_list match_list;
+
+struct match_list {
+	size_t* pos;
+	size_t n, cap;
+};
+
+/* Many from -> to rules compiled into one Aho-Corasick automaton. */
+/* next is the dense transition table, 256 entries per state with */
+/* failure links already folded in; depth is how far a state is from */
+/* the root, and out the rule with the longest pattern ending there */
+typedef struct ac_automaton ac_automaton;
+
+struct ac_automaton {
+	int32_t* next;
+	int* depth;
+	int* out;
+	int nstates, cap;
+	int nrules;
+	size_t* len;
+	const char** to;
+	size_t* tolen;
+};
+
+void searcher_init(searcher* s, const char* pat, size_t m);
+const char* search(const searcher* s, const char* hay, size_t n);
+void find_replace(char* src, char* from, char* to, char* dest);
+char* find_replace_dup(const char* src, size_t n, const char* from,
+					   const char* to, size_t* outlen);
+int find_replace_stream(int in, int out, const char* from, const char* to);
+long find_replace_inplace(const char* path, const char* from, const char* to);
+ac_automaton* ac_build(const char** from, const char** to, int n);
+void ac_free(ac_automaton* a);
+char* ac_replace(const ac_automaton* a, const char* src, size_t n,
+				 size_t* outlen);
+int multi_replace(const char* rules, int in, int out);
+char* find_replace_mt(const char* src, size_t n, const char* from,
+					  const char* to, int nthreads, size_t* outlen);
+static char* read_all(int fd, size_t* len);
+static void bench(size_t len);
 
 int main(int argc, char *argv[]) {
+  if ((argc == 4 || argc == 5) && !strcmp(argv[1], "-s")) {
+    int in = argc == 5 ? open(argv[4], O_RDONLY) : STDIN_FILENO;
+    if (in < 0) {
+      fprintf(stderr, "Cannot open %s\n", argv[4]);
+      return 1;
+    }
+    if (find_replace_stream(in, STDOUT_FILENO, argv[2], argv[3])) {
+      fprintf(stderr, "Read or write failed\n");
+      return 1;
+    }
+    return 0;
+  }
+  if (argc == 5 && !strcmp(argv[1], "-i")) {
+    long n = find_replace_inplace(argv[4], argv[2], argv[3]);
+    if (n < 0)
+      return 1;
+    fprintf(stderr, "%ld replaced\n", n);
+    return 0;
+  }
+  if ((argc == 3 || argc == 4) && !strcmp(argv[1], "-m")) {
+    int in = argc == 4 ? open(argv[3], O_RDONLY) : STDIN_FILENO;
+    if (in < 0) {
+      fprintf(stderr, "Cannot open %s\n", argv[3]);
+      return 1;
+    }
+    return multi_replace(argv[2], in, STDOUT_FILENO) ? 1 : 0;
+  }
+  if ((argc == 5 || argc == 6) && !strcmp(argv[1], "-j")) {
+    int in = argc == 6 ? open(argv[5], O_RDONLY) : STDIN_FILENO;
+    size_t len, outlen;
+    char *text = in < 0 ? NULL : read_all(in, &len), *result;
+    if (!text) {
+      fprintf(stderr, "Cannot read %s\n", argc == 6 ? argv[5] : "input");
+      return 1;
+    }
+    result = find_replace_mt(text, len, argv[3], argv[4], atoi(argv[2]), &outlen);
+    fwrite(result ? result : text, 1, outlen, stdout);
+    free(result);
+    free(text);
+    return 0;
+  }
+  if ((argc == 2 || argc == 3) && !strcmp(argv[1], "-b")) {
+    bench((argc == 3 ? atol(argv[2]) : 1) << 20);
+    return 0;
+  }
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s text from to\n"
+            "       %s -s from to [file]\n"
+            "       %s -i from to file\n"
+            "       %s -m rules [file]\n"
+            "       %s -j threads from to [file]\n"
+            "       %s -b [megabytes]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+  }
   char *src = argv[1];
   char *from = argv[2];
   char *to = argv[3];
-  char dest[100] = {0};
-  find_replace(src, from, to, dest);
-  int i;
-  for (i = 0 ; i < strlen(dest); i++)
-	printf("%c", dest[i]);
+  size_t len;
+  char *dest = find_replace_dup(src, strlen(src), from, to, &len);
+  fwrite(dest ? dest : src, 1, len, stdout);
   printf("\n");
+  free(dest);
   return 0;
 }
 
+/* maximal suffix of pat under < (rev == 0) or > (rev == 1); */
+/* returns its start minus one and stores its period in *per */
+static size_t max_suffix(const unsigned char* n, size_t m, int rev, size_t* per)
+{
+	size_t ip = -1, jp = 0, k = 1, p = 1;
+	while (jp + k < m) {
+		unsigned char a = n[ip+k], b = n[jp+k];
+		if (a == b) {
+			if (k == p) {
+				jp += p;
+				k = 1;
+			} else
+				k++;
+		} else if (rev ? a < b : a > b) {
+			jp += k;
+			k = 1;
+			p = jp - ip;
+		} else {
+			ip = jp++;
+			k = p = 1;
+		}
+	}
+	*per = p;
+	return ip;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* whether filter may use AVX2; found once, by the first */
+/* searcher_init, so searches on any thread only read it */
+static int avx2;
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+
+static void cpu_detect(void)
+{
+	avx2 = __builtin_cpu_supports("avx2");
+}
+#endif
+
+void searcher_init(searcher* s, const char* pat, size_t m)
+{
+	const unsigned char* n = (const unsigned char*)pat;
+	size_t i, ms, p, ms2, p2;
+#if defined(__x86_64__) || defined(__i386__)
+	pthread_once(&cpu_once, cpu_detect);
+#endif
+	s->pat = pat;
+	s->m = m;
+	if (m < SHORT_PATTERN)
+		return;
+	memset(s->shift, 0, sizeof(s->shift));
+	for (i = 0; i < m; i++)
+		s->shift[n[i]] = i + 1;
+	/* the critical factorization is the later of the two suffixes */
+	ms = max_suffix(n, m, 0, &p);
+	ms2 = max_suffix(n, m, 1, &p2);
+	if (ms2 + 1 > ms + 1) {
+		ms = ms2;
+		p = p2;
+	}
+	if (memcmp(n, n + p, ms + 1)) {
+		/* not periodic: any shift past the longer half is safe */
+		s->mem0 = 0;
+		s->p = (ms > m - ms - 1 ? ms : m - ms - 1) + 1;
+	} else {
+		s->mem0 = m - p;
+		s->p = p;
+	}
+	s->ms = ms;
+}
+
+/* Two-Way search: O(n + m) comparisons whatever the input, */
+/* with a skip on the window's last byte for the common case */
+static const char* two_way(const searcher* s, const char* hay, size_t len)
+{
+	const unsigned char* h = (const unsigned char*)hay;
+	const unsigned char* z = h + len;
+	const unsigned char* n = (const unsigned char*)s->pat;
+	size_t m = s->m, ms = s->ms, k, mem = 0;
+	while ((size_t)(z - h) >= m) {
+		k = s->shift[h[m-1]];
+		if (!k) {
+			h += m;
+			mem = 0;
+			continue;
+		}
+		if ((k = m - k)) {
+			/* inside a periodic match, do not fall short of a period */
+			if (s->mem0 && mem && k < s->p)
+				k = m - s->p;
+			h += k;
+			mem = 0;
+			continue;
+		}
+		for (k = ms + 1 > mem ? ms + 1 : mem; k < m && n[k] == h[k]; k++)
+			;
+		if (k < m) {
+			h += k - ms;
+			mem = 0;
+			continue;
+		}
+		for (k = ms + 1; k > mem && n[k-1] == h[k-1]; k--)
+			;
+		if (k <= mem)
+			return (const char*)h;
+		h += s->p;
+		mem = s->mem0;
+	}
+	return NULL;
+}
+
+/* candidates that fail the full check may cost at most this much */
+/* per byte scanned before the search hands over to Two-Way, which */
+/* keeps worst cases such as aaa...a in aaa...a linear */
+#define FILTER_WORK(scanned) (2 * (size_t)(scanned) + 4096)
+
+/* one position at a time, for the tail and for targets without SIMD */
+static const char* filter_scalar(const searcher* s, const char* hay,
+								 const char* h, size_t n, size_t work)
+{
+	const char* end = hay + n - s->m + 1;
+	size_t m = s->m;
+	for (; h < end; h++) {
+		if (h[0] != s->pat[0] || h[m-1] != s->pat[m-1])
+			continue;
+		if (!memcmp(h + 1, s->pat + 1, m - 2))
+			return h;
+		if ((work += m) > FILTER_WORK(h - hay))
+			return two_way(s, h + 1, hay + n - (h + 1));
+	}
+	return NULL;
+}
+
+#ifdef __SSE2__
+static const char* filter_sse2(const searcher* s, const char* hay, size_t n)
+{
+	const char* h = hay;
+	const char* end = hay + n - s->m + 1;
+	size_t m = s->m, work = 0;
+	__m128i first = _mm_set1_epi8(s->pat[0]);
+	__m128i last = _mm_set1_epi8(s->pat[m-1]);
+	for (; h + 16 <= end; h += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)h);
+		__m128i b = _mm_loadu_si128((const __m128i*)(h + m - 1));
+		unsigned mask = _mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask) {
+			int i = __builtin_ctz(mask);
+			if (!memcmp(h + i + 1, s->pat + 1, m - 2))
+				return h + i;
+			work += m;
+			mask &= mask - 1;
+		}
+		if (work > FILTER_WORK(h - hay))
+			return two_way(s, h + 16, hay + n - (h + 16));
+	}
+	return filter_scalar(s, hay, h, n, work);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static const char* filter_avx2(const searcher* s, const char* hay, size_t n)
+{
+	const char* h = hay;
+	const char* end = hay + n - s->m + 1;
+	size_t m = s->m, work = 0;
+	__m256i first = _mm256_set1_epi8(s->pat[0]);
+	__m256i last = _mm256_set1_epi8(s->pat[m-1]);
+	for (; h + 32 <= end; h += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)h);
+		__m256i b = _mm256_loadu_si256((const __m256i*)(h + m - 1));
+		unsigned mask = _mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+							 _mm256_cmpeq_epi8(b, last)));
+		while (mask) {
+			int i = __builtin_ctz(mask);
+			if (!memcmp(h + i + 1, s->pat + 1, m - 2))
+				return h + i;
+			work += m;
+			mask &= mask - 1;
+		}
+		if (work > FILTER_WORK(h - hay))
+			return two_way(s, h + 32, hay + n - (h + 32));
+	}
+	return filter_scalar(s, hay, h, n, work);
+}
+#endif
+
+/* the widest filter this CPU runs */
+static const char* filter(const searcher* s, const char* hay, size_t n)
+{
+	if (n < s->m)
+		return NULL;
+#if defined(__x86_64__) || defined(__i386__)
+	if (avx2)
+		return filter_avx2(s, hay, n);
+#endif
+#ifdef __SSE2__
+	return filter_sse2(s, hay, n);
+#else
+	return filter_scalar(s, hay, hay, n, 0);
+#endif
+}
+
+/* first occurrence of the pattern in the n bytes at hay, or NULL */
+const char* search(const searcher* s, const char* hay, size_t n)
+{
+	const char* end = hay + n;
+	if (s->m == 0)
+		return hay;
+	if (s->m > FILTER_PATTERN)
+		return two_way(s, hay, n);
+	if (s->m >= SHORT_PATTERN)
+		return filter(s, hay, n);
+	while ((size_t)(end - hay) >= s->m
+		   && (hay = memchr(hay, s->pat[0], end - hay - s->m + 1))) {
+		if (!memcmp(hay + 1, s->pat + 1, s->m - 1))
+			return hay;
+		hay++;
+	}
+	return NULL;
+}
+
+/* dest must have room for the result; find_replace_dup sizes it */
 void find_replace(char* src, char* from, char* to, char* dest)
 {
-	int i = 0, j = 0, n = 0;
 	int srclen = strlen(src);
 	int frlen = strlen(from);
 	int tolen = strlen(to);
-	if (strlen(to) > strlen(from)) {
+	const char *p, *end = src + srclen;
+	searcher s;
+	searcher_init(&s, from, frlen);
+	while (frlen && (p = search(&s, src, end - src))) {
+		memcpy(dest, src, p - src);
+		dest += p - src;
+		memcpy(dest, to, tolen);
+		dest += tolen;
+		src = (char*)p + frlen;
+	}
+	memcpy(dest, src, end - src);
+	dest[end - src] = 0;
+}
+
+static void match_add(match_list* ml, size_t pos)
+{
+	if (ml->n == ml->cap) {
+		ml->cap = ml->cap ? ml->cap * 2 : 64;
+		ml->pos = realloc(ml->pos, ml->cap * sizeof(size_t));
+	}
+	ml->pos[ml->n++] = pos;
+}
+
+/* every non-overlapping match, leftmost first */
+static void find_all(const searcher* s, const char* src, size_t n,
+					 match_list* ml)
+{
+	const char *p, *h = src, *end = src + n;
+	while (s->m && (p = search(s, h, end - h))) {
+		match_add(ml, p - src);
+		h = p + s->m;
+	}
+}
+
+/* copy src[from, end) to dest with the m bytes at each of the */
+/* npos match positions replaced by to; no terminating 0 */
+static void splice(const char* src, size_t from, size_t end,
+				   const size_t* pos, size_t npos,
+				   size_t m, const char* to, size_t tolen, char* dest)
+{
+	size_t i;
+	for (i = 0; i < npos; i++) {
+		memcpy(dest, src + from, pos[i] - from);
+		dest += pos[i] - from;
+		memcpy(dest, to, tolen);
+		dest += tolen;
+		from = pos[i] + m;
+	}
+	memcpy(dest, src + from, end - from);
+}
+
+/* Replace from with to, whatever their lengths, in the n bytes at */
+/* src. The matches are found first so the result takes exactly one */
+/* allocation of *outlen + 1 bytes. Returns NULL, with *outlen = n, */
+/* when nothing matches: src is then the result and nothing is copied */
+char* find_replace_dup(const char* src, size_t n, const char* from,
+					   const char* to, size_t* outlen)
+{
+	size_t m = strlen(from), tolen = strlen(to);
+	match_list ml = {NULL, 0, 0};
+	searcher s;
+	char* dest;
+	searcher_init(&s, from, m);
+	find_all(&s, src, n, &ml);
+	*outlen = n;
+	if (!ml.n)
+		return NULL;
+	*outlen = n - ml.n * m + ml.n * tolen;
+	if (!(dest = malloc(*outlen + 1))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	splice(src, 0, n, ml.pos, ml.n, m, to, tolen, dest);
+	dest[*outlen] = 0;
+	free(ml.pos);
+	return dest;
+}
+
+/* writev all of iov, picking up after short writes */
+static int write_all(int fd, struct iovec* iov, int n)
+{
+	while (n > 0) {
+		ssize_t w = writev(fd, iov, n);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		while (n > 0 && (size_t)w >= iov->iov_len) {
+			w -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char*)iov->iov_base + w;
+			iov->iov_len -= w;
+		}
+	}
+	return 0;
+}
+
+/* read until buf is full or the input ends */
+static ssize_t read_full(int fd, char* buf, size_t n)
+{
+	size_t got = 0;
+	while (got < n) {
+		ssize_t r = read(fd, buf + got, n - got);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		if (r == 0)
+			break;
+		got += r;
+	}
+	return got;
+}
+
+static void iov_add(struct iovec* iov, int* n, const char* p, size_t len)
+{
+	if (len) {
+		iov[*n].iov_base = (void*)p;
+		iov[*n].iov_len = len;
+		(*n)++;
+	}
+}
+
+/* Copy in to out with every from replaced by to, STREAM_BLOCK bytes */
+/* at a time. The last strlen(from)-1 bytes of a block are carried */
+/* into the next, since a match may start there; everything before */
+/* them is settled and goes out in one writev. Returns 0, or -1 if */
+/* a read or write failed */
+int find_replace_stream(int in, int out, const char* from, const char* to)
+{
+	size_t m = strlen(from), tolen = strlen(to), have = 0;
+	char* buf = malloc(STREAM_BLOCK + m);
+	struct iovec iov[IOV_BATCH];
+	searcher s;
+	int rv = 0;
+	searcher_init(&s, from, m);
+	while (!rv) {
+		ssize_t n = read_full(in, buf + have, STREAM_BLOCK);
+		const char *h = buf, *p, *end;
+		int niov = 0, eof;
+		if (n < 0) {
+			rv = -1;
+			break;
+		}
+		eof = n < STREAM_BLOCK;
+		end = buf + have + n;
+		while (m && (p = search(&s, h, end - h))) {
+			if (niov + 2 > IOV_BATCH) {
+				rv |= write_all(out, iov, niov);
+				niov = 0;
+			}
+			iov_add(iov, &niov, h, p - h);
+			iov_add(iov, &niov, to, tolen);
+			h = p + m;
+		}
+		/* no match starts before end - (m - 1) any more */
+		p = eof || !m ? end : end - (m - 1) > h ? end - (m - 1) : h;
+		iov_add(iov, &niov, h, p - h);
+		rv |= write_all(out, iov, niov);
+		if (eof)
+			break;
+		have = end - p;
+		memmove(buf, p, have);
+	}
+	free(buf);
+	return rv;
+}
+
+/* Replace from with to inside the file itself, which needs the two */
+/* to be the same length. The file is mapped shared and patched in */
+/* place: only pages holding a changed match are dirtied, so only */
+/* they are written back, and only their span is synced. Returns */
+/* the number of matches, or -1 on error */
+long find_replace_inplace(const char* path, const char* from, const char* to)
+{
+	size_t m = strlen(from), lo = (size_t)-1, hi = 0, page;
+	long count = 0;
+	struct stat st;
+	searcher s;
+	char *map, *h, *end;
+	const char* p;
+	int fd;
+	if (strlen(to) != m) {
 		fprintf(stderr,
-			"Error in input: 'to' is longer than 'from'");
+			"Error in input: in-place needs 'to' as long as 'from'\n");
+		return -1;
+	}
+	if ((fd = open(path, O_RDWR)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (!m || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Cannot map %s\n", path);
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	searcher_init(&s, from, m);
+	h = map;
+	end = map + st.st_size;
+	while ((p = search(&s, h, end - h))) {
+		/* leave pages whose bytes would not change clean */
+		if (memcmp(p, to, m)) {
+			memcpy((char*)p, to, m);
+			if ((size_t)(p - map) < lo)
+				lo = p - map;
+			hi = p - map + m;
+		}
+		count++;
+		h = (char*)p + m;
+	}
+	page = sysconf(_SC_PAGESIZE);
+	if (hi && msync(map + lo / page * page, hi - lo / page * page, MS_SYNC)) {
+		fprintf(stderr, "Cannot write back %s\n", path);
+		count = -1;
+	}
+	munmap(map, st.st_size);
+	return count;
+}
+
+static int ac_state(ac_automaton* a, int depth)
+{
+	if (a->nstates == a->cap) {
+		a->cap *= 2;
+		a->next = realloc(a->next, sizeof(int32_t) * 256 * a->cap);
+		a->depth = realloc(a->depth, sizeof(int) * a->cap);
+		a->out = realloc(a->out, sizeof(int) * a->cap);
+	}
+	memset(a->next + 256 * a->nstates, -1, sizeof(int32_t) * 256);
+	a->depth[a->nstates] = depth;
+	a->out[a->nstates] = -1;
+	return a->nstates++;
+}
+
+/* Compile n rules; from and to must outlive the automaton. Empty */
+/* patterns never match, and of two equal patterns the first wins */
+ac_automaton* ac_build(const char** from, const char** to, int n)
+{
+	ac_automaton* a = malloc(sizeof(ac_automaton));
+	int *fail, *queue, head = 0, tail = 0, i, c;
+	a->cap = 64;
+	a->nstates = 0;
+	a->next = malloc(sizeof(int32_t) * 256 * a->cap);
+	a->depth = malloc(sizeof(int) * a->cap);
+	a->out = malloc(sizeof(int) * a->cap);
+	a->nrules = n;
+	a->len = malloc(sizeof(size_t) * n);
+	a->tolen = malloc(sizeof(size_t) * n);
+	a->to = to;
+	ac_state(a, 0);
+	for (i = 0; i < n; i++) {
+		const unsigned char* p = (const unsigned char*)from[i];
+		int st = 0;
+		a->len[i] = strlen(from[i]);
+		a->tolen[i] = strlen(to[i]);
+		for (; *p; p++) {
+			if (a->next[256 * st + *p] < 0) {
+				int ns = ac_state(a, a->depth[st] + 1);
+				a->next[256 * st + *p] = ns;
+			}
+			st = a->next[256 * st + *p];
+		}
+		if (st && a->out[st] < 0)
+			a->out[st] = i;
+	}
+	/* breadth first, so a state's failure link is settled before */
+	/* its children need it; missing edges borrow the failure's */
+	fail = malloc(sizeof(int) * a->nstates);
+	queue = malloc(sizeof(int) * a->nstates);
+	fail[0] = 0;
+	for (c = 0; c < 256; c++) {
+		if (a->next[c] < 0)
+			a->next[c] = 0;
+		else {
+			fail[a->next[c]] = 0;
+			queue[tail++] = a->next[c];
+		}
+	}
+	while (head < tail) {
+		int u = queue[head++];
+		if (a->out[u] < 0)
+			a->out[u] = a->out[fail[u]];
+		for (c = 0; c < 256; c++) {
+			int v = a->next[256 * u + c];
+			if (v < 0)
+				a->next[256 * u + c] = a->next[256 * fail[u] + c];
+			else {
+				fail[v] = a->next[256 * fail[u] + c];
+				queue[tail++] = v;
+			}
+		}
+	}
+	free(fail);
+	free(queue);
+	return a;
+}
+
+void ac_free(ac_automaton* a)
+{
+	free(a->next);
+	free(a->depth);
+	free(a->out);
+	free(a->len);
+	free(a->tolen);
+	free(a);
+}
+
+/* Apply every rule in one pass, leftmost-longest: of all matches */
+/* the one starting first wins, the longest of those, and scanning */
+/* resumes after it. A candidate is final once the automaton's */
+/* state no longer reaches back to its start, since no later match */
+/* can then begin at or before it. Same result contract as */
+/* find_replace_dup: NULL with *outlen = n when nothing matches */
+char* ac_replace(const ac_automaton* a, const char* src, size_t n,
+				 size_t* outlen)
+{
+	const unsigned char* t = (const unsigned char*)src;
+	match_list ml = {NULL, 0, 0};
+	int* rule = NULL;
+	size_t i = 0, k, start = 0, len = 0, from = 0;
+	int st = 0, cand = -1;
+	char *dest, *d;
+	*outlen = n;
+	while (i < n || cand >= 0) {
+		if (i < n) {
+			st = a->next[256 * st + t[i++]];
+			if (cand < 0 || i - a->depth[st] <= start) {
+				int r = a->out[st];
+				if (r >= 0 && (cand < 0 || i - a->len[r] < start
+							   || (i - a->len[r] == start && a->len[r] > len))) {
+					cand = r;
+					start = i - a->len[r];
+					len = a->len[r];
+				}
+				continue;
+			}
+		}
+		if (ml.n == ml.cap)
+			rule = realloc(rule, sizeof(int) * (ml.cap ? ml.cap * 2 : 64));
+		rule[ml.n] = cand;
+		match_add(&ml, start);
+		*outlen += a->tolen[cand] - len;
+		i = start + len;
+		st = 0;
+		cand = -1;
+	}
+	if (!ml.n)
+		return NULL;
+	if (!(d = dest = malloc(*outlen + 1))) {
+		fprintf(stderr, "Out of memory\n");
 		exit(1);
-	} else {
-		while (i < srclen) {
-			while (src[i+n] == from[n]) 
-				n++;
-			if (n != frlen) {
-				dest[j] = src[i];
-				n = 0;
-				i++, j++;
-			} else {
-				for (n = 0; n < tolen; n++, j++)
-					dest[j] = to[n];
-				n = 0;
-				i = i + frlen; 
+	}
+	for (k = 0; k < ml.n; k++) {
+		memcpy(d, src + from, ml.pos[k] - from);
+		d += ml.pos[k] - from;
+		memcpy(d, a->to[rule[k]], a->tolen[rule[k]]);
+		d += a->tolen[rule[k]];
+		from = ml.pos[k] + a->len[rule[k]];
+	}
+	memcpy(d, src + from, n - from);
+	d[n - from] = 0;
+	free(ml.pos);
+	free(rule);
+	return dest;
+}
+
+/* all of fd in one buffer */
+static char* read_all(int fd, size_t* len)
+{
+	size_t cap = STREAM_BLOCK;
+	char* buf = malloc(cap);
+	ssize_t r;
+	*len = 0;
+	while ((r = read_full(fd, buf + *len, cap - *len)) > 0) {
+		*len += r;
+		if (*len == cap)
+			buf = realloc(buf, cap *= 2);
+	}
+	if (r < 0) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+/* Apply the rules file, one "from<TAB>to" per line, to all of in */
+int multi_replace(const char* rules, int in, int out)
+{
+	int fd = open(rules, O_RDONLY), n = 0, cap = 64, rv;
+	size_t rlen, len, outlen;
+	char *text, *line, *result;
+	const char **from, **to;
+	struct iovec iov;
+	ac_automaton* a;
+	char* r = fd < 0 ? NULL : read_all(fd, &rlen);
+	if (fd >= 0)
+		close(fd);
+	if (!r) {
+		fprintf(stderr, "Cannot read %s\n", rules);
+		return -1;
+	}
+	r = realloc(r, rlen + 1);
+	r[rlen] = 0;
+	from = malloc(sizeof(char*) * cap);
+	to = malloc(sizeof(char*) * cap);
+	for (line = strtok(r, "\n"); line; line = strtok(NULL, "\n")) {
+		char* tab = strchr(line, '\t');
+		if (!tab) {
+			fprintf(stderr, "Rule without a tab: %s\n", line);
+			return -1;
+		}
+		*tab = 0;
+		if (n == cap) {
+			from = realloc(from, sizeof(char*) * (cap *= 2));
+			to = realloc(to, sizeof(char*) * cap);
+		}
+		from[n] = line;
+		to[n++] = tab + 1;
+	}
+	a = ac_build(from, to, n);
+	if (!(text = read_all(in, &len))) {
+		fprintf(stderr, "Read failed\n");
+		return -1;
+	}
+	result = ac_replace(a, text, len, &outlen);
+	iov.iov_base = result ? result : text;
+	iov.iov_len = outlen;
+	if ((rv = write_all(out, &iov, 1)))
+		fprintf(stderr, "Write failed\n");
+	free(result);
+	free(text);
+	ac_free(a);
+	free(from);
+	free(to);
+	free(r);
+	return rv;
+}
+
+/* One thread's share: it finds the matches that start in [lo, hi) */
+/* as if scanning began at lo, then copies out src[a, b) */
+typedef struct chunk chunk;
+
+struct chunk {
+	const searcher* s;
+	const char* src;
+	size_t n, lo, hi;
+	match_list ml;
+	size_t a, b;
+	char* dest;
+	const char* to;
+	size_t tolen;
+};
+
+static void* chunk_find(void* arg)
+{
+	chunk* c = arg;
+	size_t end = c->hi + c->s->m - 1 < c->n ? c->hi + c->s->m - 1 : c->n;
+	size_t i;
+	find_all(c->s, c->src + c->lo, end - c->lo, &c->ml);
+	for (i = 0; i < c->ml.n; i++)
+		c->ml.pos[i] += c->lo;
+	return NULL;
+}
+
+static void* chunk_copy(void* arg)
+{
+	chunk* c = arg;
+	splice(c->src, c->a, c->b, c->ml.pos, c->ml.n, c->s->m,
+		   c->to, c->tolen, c->dest);
+	return NULL;
+}
+
+/* fn on each of the k chunks: chunk 0 on the calling thread, the */
+/* rest on threads of their own for as long as threads can be had */
+/* and on the calling thread after that */
+static void run_chunks(chunk* c, int k, void* (*fn)(void*))
+{
+	pthread_t* th = malloc(sizeof(pthread_t) * k);
+	int i, n = 1;
+	while (th && n < k && !pthread_create(&th[n], NULL, fn, &c[n]))
+		n++;
+	fn(&c[0]);
+	for (i = n; i < k; i++)
+		fn(&c[i]);
+	for (i = 1; i < n; i++)
+		pthread_join(th[i], NULL);
+	free(th);
+}
+
+/* A match that runs past its chunk's end shifts where the serial */
+/* scan resumes in the next chunk. Rescan from there until the scan */
+/* lands on a match the chunk found itself; from that match on, the */
+/* two scans agree, so the rest of the chunk's list stands */
+static void chunk_fix(chunk* c, size_t pos)
+{
+	match_list ml = {NULL, 0, 0};
+	const char* p;
+	size_t i = 0;
+	while (pos < c->hi && (p = search(c->s, c->src + pos, c->n - pos))) {
+		size_t q = p - c->src;
+		if (q >= c->hi)
+			break;
+		while (i < c->ml.n && c->ml.pos[i] < q)
+			i++;
+		if (i < c->ml.n && c->ml.pos[i] == q) {
+			for (; i < c->ml.n; i++)
+				match_add(&ml, c->ml.pos[i]);
+			break;
+		}
+		match_add(&ml, q);
+		pos = q + c->s->m;
+	}
+	free(c->ml.pos);
+	c->ml = ml;
+}
+
+/* find_replace_dup split over nthreads threads. Chunks are scanned */
+/* with an overlap of strlen(from)-1 bytes, stitched in order so */
+/* boundary matches are neither lost nor counted twice, and copied */
+/* out in parallel at offsets from a prefix sum of their sizes. */
+/* The result is the same as find_replace_dup's */
+char* find_replace_mt(const char* src, size_t n, const char* from,
+					  const char* to, int nthreads, size_t* outlen)
+{
+	size_t m = strlen(from), tolen = strlen(to), pos = 0, off = 0, total = 0;
+	size_t most = n / MT_MIN_CHUNK;
+	int k = (int)(most < (size_t)nthreads ? most : (size_t)nthreads);
+	searcher s;
+	chunk* c;
+	char* dest;
+	int i;
+	if (k <= 1 || !m)
+		return find_replace_dup(src, n, from, to, outlen);
+	searcher_init(&s, from, m);
+	c = calloc(k, sizeof(chunk));
+	for (i = 0; i < k; i++) {
+		c[i].s = &s;
+		c[i].src = src;
+		c[i].n = n;
+		c[i].lo = n / k * i;
+		c[i].hi = i == k - 1 ? n : n / k * (i + 1);
+		c[i].to = to;
+		c[i].tolen = tolen;
+	}
+	run_chunks(c, k, chunk_find);
+	for (i = 0; i < k; i++) {
+		if (pos > c[i].lo)
+			chunk_fix(&c[i], pos);
+		c[i].a = pos > c[i].lo ? pos : c[i].lo;
+		if (c[i].ml.n)
+			pos = c[i].ml.pos[c[i].ml.n - 1] + m;
+		total += c[i].ml.n;
+	}
+	*outlen = n;
+	if (!total) {
+		for (i = 0; i < k; i++)
+			free(c[i].ml.pos);
+		free(c);
+		return NULL;
+	}
+	*outlen = n - total * m + total * tolen;
+	if (!(dest = malloc(*outlen + 1))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < k; i++) {
+		c[i].b = i == k - 1 ? n : c[i+1].a;
+		c[i].dest = dest + off;
+		off += c[i].b - c[i].a - c[i].ml.n * m + c[i].ml.n * tolen;
+	}
+	run_chunks(c, k, chunk_copy);
+	dest[*outlen] = 0;
+	for (i = 0; i < k; i++)
+		free(c[i].ml.pos);
+	free(c);
+	return dest;
+}
+
+/* -b: time the search on its worst cases, and many rules at once */
+/* against one rule at a time, one CSV line per run: */
+/*   case,method,bytes,seconds,mb_per_s */
+/* Each case is run for at least BENCH_SECONDS */
+#define BENCH_SECONDS 0.25
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_report(const char* name, const char* method, size_t bytes,
+						 double secs)
+{
+	printf("%s,%s,%zu,%.4f,%.1f\n", name, method, bytes, secs,
+		   bytes / secs / 1e6);
+	fflush(stdout);
+}
+
+/* non-overlapping matches of pat in hay, found by search */
+static size_t count_search(const searcher* s, const char* hay, size_t n)
+{
+	const char *p, *end = hay + n;
+	size_t count = 0;
+	while ((p = search(s, hay, end - hay))) {
+		count++;
+		hay = p + s->m;
+	}
+	return count;
+}
+
+/* the same, trying every position in turn: O(n * m) on these cases */
+static size_t count_naive(const char* hay, size_t n, const char* pat,
+						  size_t m)
+{
+	size_t i = 0, count = 0;
+	while (i + m <= n) {
+		if (!memcmp(hay + i, pat, m)) {
+			count++;
+			i += m;
+		} else
+			i++;
+	}
+	return count;
+}
+
+/* every match of pat in the len bytes at hay, by search and by */
+/* the naive scan */
+static void bench_search(const char* name, const char* hay, size_t len,
+						 const char* pat, size_t m)
+{
+	size_t found = 0, expect = 0;
+	double t0, secs;
+	long i, reps;
+	searcher s;
+	searcher_init(&s, pat, m);
+	for (reps = 1, secs = 0; secs < BENCH_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			found = count_search(&s, hay, len);
+		secs = now() - t0;
+	}
+	bench_report(name, "search", len * (reps / 2), secs);
+	for (reps = 1, secs = 0; secs < BENCH_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			expect = count_naive(hay, len, pat, m);
+		secs = now() - t0;
+	}
+	bench_report(name, "naive", len * (reps / 2), secs);
+	if (found != expect)
+		fprintf(stderr, "%s: search and naive scan disagree\n", name);
+}
+
+static uint64_t bench_seed = 0x9E3779B97F4A7C15ULL;
+
+/* xorshift64*, so every run sees the same text */
+static uint64_t rnd(void)
+{
+	bench_seed ^= bench_seed >> 12;
+	bench_seed ^= bench_seed << 25;
+	bench_seed ^= bench_seed >> 27;
+	return bench_seed * 2685821657736338717ULL;
+}
+
+/* n rules w000 -> r000, w001 -> r001, ... over len bytes of those */
+/* words, applied by ac_replace in one pass and by n find_replace_dup */
+/* passes in turn. The words are all one length and no rule's output */
+/* matches another rule, so both must give the same text */
+static void bench_rules(size_t len, int n)
+{
+	char** from = malloc(sizeof(char*) * n);
+	char** to = malloc(sizeof(char*) * n);
+	char *text = malloc(len + 1), *ac = NULL, *seq = NULL, *t;
+	size_t i, aclen = 0, seqlen = 0, tlen;
+	ac_automaton* a;
+	char name[32];
+	double t0, secs;
+	long r, reps;
+	int k;
+	for (k = 0; k < n; k++) {
+		from[k] = malloc(5);
+		to[k] = malloc(5);
+		snprintf(from[k], 5, "w%03d", k);
+		snprintf(to[k], 5, "r%03d", k);
+	}
+	/* words from rules and words from none, half and half */
+	for (i = 0; i + 5 <= len; i += 5)
+		snprintf(text + i, 6, "w%03d ", (int)(rnd() % (2 * n)));
+	memset(text + i, ' ', len - i);
+	text[len] = 0;
+	snprintf(name, sizeof(name), "rules%d", n);
+	a = ac_build((const char**)from, (const char**)to, n);
+	for (reps = 1, secs = 0; secs < BENCH_SECONDS; reps *= 2) {
+		t0 = now();
+		for (r = 0; r < reps; r++) {
+			free(ac);
+			ac = ac_replace(a, text, len, &aclen);
+		}
+		secs = now() - t0;
+	}
+	bench_report(name, "aho_corasick", len * (reps / 2), secs);
+	for (reps = 1, secs = 0; secs < BENCH_SECONDS; reps *= 2) {
+		t0 = now();
+		for (r = 0; r < reps; r++) {
+			free(seq);
+			seq = NULL;
+			seqlen = len;
+			for (k = 0; k < n; k++) {
+				t = find_replace_dup(seq ? seq : text, seqlen, from[k], to[k],
+									 &tlen);
+				if (t) {
+					free(seq);
+					seq = t;
+				}
+				seqlen = tlen;
 			}
 		}
+		secs = now() - t0;
+	}
+	bench_report(name, "sequential", len * (reps / 2), secs);
+	if (aclen != seqlen || memcmp(ac ? ac : text, seq ? seq : text, aclen))
+		fprintf(stderr, "%s: one pass and sequential passes disagree\n", name);
+	ac_free(a);
+	for (k = 0; k < n; k++) {
+		free(from[k]);
+		free(to[k]);
 	}
+	free(from);
+	free(to);
+	free(text);
+	free(ac);
+	free(seq);
 }
 
-int main() {
-	return 0;
-}
\ No newline at end of file
+/* a...ab and a...a in len bytes of a, at pattern lengths on each */
+/* of search's paths: memchr, the SIMD filter and Two-Way; then */
+/* 1 to 256 rules at once, in one pass and one pass per rule */
+static void bench(size_t len)
+{
+	static const size_t lens[] = {3, 16, 32, 64, 1024};
+	char* hay = malloc(len);
+	char* pat = malloc(1024);
+	char name[64];
+	size_t i;
+	memset(hay, 'a', len);
+	memset(pat, 'a', 1024);
+	printf("case,method,bytes,seconds,mb_per_s\n");
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		size_t m = lens[i];
+		pat[m-1] = 'b';
+		snprintf(name, sizeof(name), "a%zub_in_a", m - 1);
+		bench_search(name, hay, len, pat, m);
+		pat[m-1] = 'a';
+		snprintf(name, sizeof(name), "a%zu_in_a", m);
+		bench_search(name, hay, len, pat, m);
+	}
+	for (i = 1; i <= 256; i *= 4)
+		bench_rules(len, i);
+	free(hay);
+	free(pat);
+}
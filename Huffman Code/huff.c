@@ -6,10 +6,90 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "huff.h"
 
+/* the arena huff objects come from on this thread, if any */
+static _Thread_local huff_arena* cur_arena;
+
+void arena_init(huff_arena* a, void* buf, size_t size) {
+	uintptr_t p = ((uintptr_t)buf + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+	a->first = NULL;
+	if (buf && size >= (p - (uintptr_t)buf) + sizeof(arena_chunk)) {
+		a->first = (arena_chunk*)p;
+		a->first->next = NULL;
+		a->first->size = size - (p - (uintptr_t)buf) - sizeof(arena_chunk);
+		a->first->owned = 0;
+	}
+	a->cur = a->first;
+	a->used = 0;
+}
+
+static char* chunk_data(arena_chunk* c) {
+	return (char*)c + sizeof(arena_chunk);
+}
+
+/* bump through the current chunk, then through chunks kept */
+/* from before the last reset, and only then ask malloc; NULL */
+/* if malloc has nothing to give, with the arena still usable */
+void* arena_alloc(huff_arena* a, size_t n) {
+	arena_chunk* c;
+	n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	while (a->cur) {
+		if (a->used + n <= a->cur->size) {
+			a->used += n;
+			return chunk_data(a->cur) + a->used - n;
+		}
+		if (!a->cur->next)
+			break;
+		a->cur = a->cur->next;
+		a->used = 0;
+	}
+	c = malloc(sizeof(arena_chunk) + (n > ARENA_CHUNK ? n : ARENA_CHUNK));
+	if (!c)
+		return NULL;
+	c->next = NULL;
+	c->size = n > ARENA_CHUNK ? n : ARENA_CHUNK;
+	c->owned = 1;
+	if (a->cur)
+		a->cur->next = c;
+	else
+		a->first = c;
+	a->cur = c;
+	a->used = n;
+	return chunk_data(c);
+}
+
+void arena_reset(huff_arena* a) {
+	a->cur = a->first;
+	a->used = 0;
+}
+
+void arena_release(huff_arena* a) {
+	arena_chunk* c = a->first;
+	while (c) {
+		arena_chunk* next = c->next;
+		if (c->owned)
+			free(c);
+		c = next;
+	}
+	a->first = a->cur = NULL;
+	a->used = 0;
+}
+
+huff_arena* huff_use_arena(huff_arena* a) {
+	huff_arena* prev = cur_arena;
+	cur_arena = a;
+	return prev;
+}
+
+static void* huff_alloc(size_t n) {
+	return cur_arena ? arena_alloc(cur_arena, n) : malloc(n);
+}
+
 huff *huff_singleton(char c, int n) {
-	huff* h = malloc(sizeof(huff));
+	huff* h = huff_alloc(sizeof(huff));
 	h->tag = LEAF;
 	h->h.leaf.c = c;
 	h->h.leaf.n = n;
@@ -34,30 +114,51 @@ void huff_show(huff *h) {
 }
 
 
+/* count every byte of s into freq in a single pass */
+/* four interleaved tables keep runs of one byte from stalling */
+/* on the previous increment of the same counter */
+void histogram(const char* s, size_t len, uint32_t* freq) {
+	const unsigned char* p = (const unsigned char*)s;
+	uint32_t t[4][256];
+	size_t i = 0;
+	int c;
+	memset(t, 0, sizeof(t));
+	for (; i + 8 <= len; i += 8) {
+		uint64_t w;
+		memcpy(&w, p + i, 8);
+		t[0][w & 255]++;
+		t[1][(w >> 8) & 255]++;
+		t[2][(w >> 16) & 255]++;
+		t[3][(w >> 24) & 255]++;
+		t[0][(w >> 32) & 255]++;
+		t[1][(w >> 40) & 255]++;
+		t[2][(w >> 48) & 255]++;
+		t[3][w >> 56]++;
+	}
+	for (; i < len; i++)
+		t[0][p[i]]++;
+	for (c = 0; c < 256; c++)
+		freq[c] = t[0][c] + t[1][c] + t[2][c] + t[3][c];
+}
+
 /* Given a string, makes an array of huff*/
 huff* h_array(char* s, int* n) {
-	int len = strlen(s);
-	int i, j;
-	huff* hl = malloc(sizeof(huff) * len);
+	uint32_t freq[256];
+	int c;
+	huff* hl;
+	histogram(s, strlen(s), freq);
 	(*n) = 0; /* n = the number of elements in hl*/
-	for (i = 0; i < len ; i++) {
-		char c = s[i];
-		for (j = 0; j < (*n); j++) {
-			if (hl[j].h.leaf.c == c) {
-				(hl[j].h.leaf.n)++;
-				j = *n;
-			}
-		}
-		if ((c >= 'a') && (c <= 'f')) {
-			c -= 32;
+	for (c = 0; c < 256; c++)
+		if (freq[c])
 			(*n)++;
-			huff_singleton(c, 1);
-		} else if ((c >= 'A') && (c <= 'F')) {
+	hl = huff_alloc(sizeof(huff) * (*n));
+	(*n) = 0;
+	for (c = 0; c < 256; c++) {
+		if (freq[c]) {
+			hl[*n].tag = LEAF;
+			hl[*n].h.leaf.c = (char)c;
+			hl[*n].h.leaf.n = freq[c];
 			(*n)++;
-			huff_singleton(c, 1);
-		} else if (c == ' ') {
-			(*n)++;
-			huff_singleton(c, 1);
 		}
 	}
 	return hl;
@@ -65,41 +166,17 @@ huff* h_array(char* s, int* n) {
 
 /* Given an array of huff and its length*/
 /* returns a huff_list*/
-huff_list* h_list(char* s) {
-	int len = strlen(s);
-	int i,j;
-	huff* ha = malloc(sizeof(huff) * len);
-	char* existing_chars = malloc(sizeof(char) * len);
-	int n_of_char = 0;
+huff_list* h_list(huff* h, int len) {
+	huff_list* first = NULL;
+	huff_list** tail = &first;
+	int i;
 	for (i = 0; i < len; i++) {
-		char curr = s[i];
-		if ((n_of_char == 0) || 
-			(strchr(existing_chars, curr) == NULL)) {
-			existing_chars[n_of_char] = curr;
-			ha[n_of_char] = (*huff_singleton(curr, 1));
-			n_of_char++;
-		} else {
-			for (j = 0; j < n_of_char; j++) {
-				if (ha[j].h.leaf.c == curr)
-					ha[j].h.leaf.n++;
-			}
-		}
-	}
-
-	huff_list* hs = malloc(sizeof(huff_list));
-	if (n_of_char == 0) 
-		hs = NULL;
-	hs->h = (&ha[0]);
-	hs->next = NULL;
-	huff_list* first = hs;
-	for (i = 1; i < n_of_char; i++) {
-		huff_list* temp = malloc(sizeof(huff_list));
-		temp->h = (&ha[i]);
+		huff_list* temp = huff_alloc(sizeof(huff_list));
+		temp->val = &h[i];
 		temp->next = NULL;
-		hs->next = temp;
-		hs = hs->next; 
+		*tail = temp;
+		tail = &temp->next;
 	}
-
 	return first; /* function working as intended*/
 }
 
@@ -142,7 +219,7 @@ void isort(huff_list* hs) {
 
 /* merge two huffs into a node(huff) */
 huff* merge(huff* h1, huff* h2) {
-	huff* result = malloc(sizeof(huff));
+	huff* result = huff_alloc(sizeof(huff));
 	result->tag = NODE;
 	result->h.node.n = huff_weight(h1) + huff_weight(h2);
 	result->h.node.lsub = h1;
@@ -164,12 +241,75 @@ void merge_list(huff_list* hs) {
 }
 
 huff* tree_maker(huff_list *hs) {
-	while (!hs->next)
+	while (hs->next) {
 		isort(hs);
 		merge_list(hs);
+	}
 	return hs->val;
 }
 
+/* A heap entry remembers the order key used to break weight ties: */
+/* leaves in symbol order, and a freshly merged node ahead of older */
+/* equals, so the tree does not hang on the heap's layout. It costs */
+/* as many bits as tree_maker's but is not always the same tree, */
+/* since isort shuffles equal weights in an order of its own */
+typedef struct heap_entry heap_entry;
+
+struct heap_entry {
+	huff *val;
+	int key;
+};
+
+static int heap_less(heap_entry* a, heap_entry* b) {
+	int wa = huff_weight(a->val), wb = huff_weight(b->val);
+	return (wa < wb) || (wa == wb && a->key < b->key);
+}
+
+static void heap_push(heap_entry* hp, int* n, huff* h, int key) {
+	int i = (*n)++;
+	heap_entry e;
+	e.val = h;
+	e.key = key;
+	while (i > 0 && heap_less(&e, &hp[(i-1)/2])) {
+		hp[i] = hp[(i-1)/2];
+		i = (i-1)/2;
+	}
+	hp[i] = e;
+}
+
+static huff* heap_pop(heap_entry* hp, int* n) {
+	huff* top = hp[0].val;
+	heap_entry last = hp[--(*n)];
+	int i = 0, c;
+	while ((c = 2*i + 1) < *n) {
+		if (c + 1 < *n && heap_less(&hp[c+1], &hp[c]))
+			c++;
+		if (!heap_less(&hp[c], &last))
+			break;
+		hp[i] = hp[c];
+		i = c;
+	}
+	hp[i] = last;
+	return top;
+}
+
+/* build a tree from a frequency table in O(n log n) */
+huff* heap_tree_maker(uint32_t* freq) {
+	heap_entry hp[256];
+	int i, n = 0, merged = 0;
+	for (i = 0; i < 256; i++)
+		if (freq[i])
+			heap_push(hp, &n, huff_singleton((char)i, freq[i]), i);
+	if (n == 0)
+		return NULL;
+	while (n > 1) {
+		huff* h1 = heap_pop(hp, &n);
+		huff* h2 = heap_pop(hp, &n);
+		heap_push(hp, &n, merge(h1, h2), -(++merged));
+	}
+	return hp[0].val;
+}
+
 /* This is done under the help of classmate Zach Krebs*/
 /* he gave suggestions of this implementation because*/
 /* mine original method is not working*/
@@ -198,20 +338,783 @@ char* path_string(huff* h, char c) {
 	char* s = malloc(len*(sizeof(char)));
 	s[len-1] = 0;
 	for (i = 0; i < len - 1; i++) 
-		s[len] = bit_puller(p,len-1-i) + '0';
+		s[i] = bit_puller(p,len-1-i) + '0';
 	return s;
 }
 
-/* print out the string and its coding*/
-void print_code(char* s) {
+/* leaves come first in character order, merged nodes after them */
+/* newest first, the order heap_tree_maker breaks ties in */
+static int flat_less(huff_tree* t, int a, int b) {
+	int wa = flat_weight(t, a), wb = flat_weight(t, b);
+	int ka = a < t->nleaves ? a : -a, kb = b < t->nleaves ? b : -b;
+	return (wa < wb) || (wa == wb && ka < kb);
+}
+
+static void flat_push(huff_tree* t, uint16_t* hp, int* n, int i) {
+	int k = (*n)++;
+	while (k > 0 && flat_less(t, i, hp[(k-1)/2])) {
+		hp[k] = hp[(k-1)/2];
+		k = (k-1)/2;
+	}
+	hp[k] = i;
+}
+
+static int flat_pop(huff_tree* t, uint16_t* hp, int* n) {
+	int top = hp[0], last = hp[--(*n)];
+	int k = 0, c;
+	while ((c = 2*k + 1) < *n) {
+		if (c + 1 < *n && flat_less(t, hp[c+1], hp[c]))
+			c++;
+		if (!flat_less(t, hp[c], last))
+			break;
+		hp[k] = hp[c];
+		k = c;
+	}
+	hp[k] = last;
+	return top;
+}
+
+int flat_tree_maker(uint32_t* freq, huff_tree* t) {
+	uint16_t hp[256];
+	int i, n = 0, next;
+	t->nleaves = 0;
+	for (i = 0; i < 256; i++) {
+		if (freq[i]) {
+			t->c[t->nleaves] = i;
+			t->leaf_n[t->nleaves] = freq[i];
+			t->node[t->nleaves].lsub = t->node[t->nleaves].rsub = FLAT_NONE;
+			t->nleaves++;
+		}
+	}
+	if (!t->nleaves)
+		return -1;
+	for (i = 0; i < t->nleaves; i++)
+		flat_push(t, hp, &n, i);
+	for (next = t->nleaves; n > 1; next++) {
+		int h1 = flat_pop(t, hp, &n);
+		int h2 = flat_pop(t, hp, &n);
+		t->node[next].lsub = h1;
+		t->node[next].rsub = h2;
+		t->node_n[next - t->nleaves] = flat_weight(t, h1) + flat_weight(t, h2);
+		flat_push(t, hp, &n, next);
+	}
+	return 2 * t->nleaves - 2;
+}
+
+int flat_weight(huff_tree* t, int i) {
+	return i < t->nleaves ? t->leaf_n[i] : t->node_n[i - t->nleaves];
+}
+
+void flat_show(huff_tree* t, int i) {
+	if (i < 0)
+		return;
+	if (i < t->nleaves) {
+		printf("Leaf: %c % d\n", t->c[i], t->leaf_n[i]);
+	} else {
+		printf("Node %d\n", flat_weight(t, i));
+		flat_show(t, t->node[i].lsub);
+		flat_show(t, t->node[i].rsub);
+	}
+}
+
+/* children always come before their parent, so one sweep down */
+/* from the root settles every node's path before its children's */
+void flat_codes(huff_tree* t, uint64_t* code, unsigned char* len) {
+	uint64_t p[511];
+	unsigned char d[511];
+	int i, root = 2 * t->nleaves - 2;
+	memset(code, 0, sizeof(uint64_t) * 256);
+	memset(len, 0, 256);
+	if (t->nleaves == 1)
+		len[t->c[0]] = 1;
+	if (t->nleaves <= 1)
+		return;
+	p[root] = 0;
+	d[root] = 0;
+	for (i = root; i >= t->nleaves; i--) {
+		int l = t->node[i].lsub, r = t->node[i].rsub;
+		p[l] = p[i] << 1;
+		p[r] = (p[i] << 1) + 1;
+		d[l] = d[r] = d[i] + 1;
+	}
+	for (i = 0; i < t->nleaves; i++) {
+		code[t->c[i]] = p[i];
+		len[t->c[i]] = d[i];
+	}
+}
+
+/* reassign codes from their lengths alone: shorter codes first, */
+/* characters of equal length in order, counting up in binary */
+void huff_canonical(unsigned char* len, uint64_t* code) {
+	int count[HUFF_MAX_LEN + 1] = {0};
+	uint64_t next[HUFF_MAX_LEN + 1];
+	uint64_t c = 0;
+	int i;
+	for (i = 0; i < 256; i++)
+		count[len[i]]++;
+	count[0] = 0;
+	for (i = 1; i <= HUFF_MAX_LEN; i++) {
+		c = (c + count[i-1]) << 1;
+		next[i] = c;
+	}
+	for (i = 0; i < 256; i++)
+		code[i] = len[i] ? next[len[i]]++ : 0;
+}
+
+static void put64(unsigned char* p, uint64_t v) {
+	int i;
+	for (i = 7; i >= 0; i--, v >>= 8)
+		p[i] = v & 255;
+}
+
+static uint64_t get64(const unsigned char* p) {
+	uint64_t v = 0;
+	int i;
+	for (i = 0; i < 8; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+/* bits collect at the bottom of acc, oldest highest, */
+/* and leave for out one whole 64-bit word at a time */
+typedef struct bit_writer bit_writer;
+
+struct bit_writer {
+	uint64_t acc;
+	int n;
+	unsigned char* out;
+};
+
+static void put_bits(bit_writer* w, uint64_t code, int len) {
+	int r;
+	if (w->n + len < 64) {
+		w->acc = (w->acc << len) | code;
+		w->n += len;
+		return;
+	}
+	/* r bits of code complete the word, the rest start the next */
+	r = 64 - w->n;
+	put64(w->out, (r == 64 ? 0 : w->acc << r) | (code >> (len - r)));
+	w->out += 8;
+	w->n = len - r;
+	w->acc = code & ((((uint64_t)1) << w->n) - 1);
+}
+
+static void flush_bits(bit_writer* w) {
+	uint64_t v = w->n ? w->acc << (64 - w->n) : 0;
+	int i;
+	for (i = 0; i < (w->n + 7) / 8; i++, v <<= 8)
+		*w->out++ = v >> 56;
+	w->n = 0;
+}
+
+size_t huff_encode_bound(size_t len) {
+	return HUFF_BLOCK_HEADER + len + 8;
+}
+
+/* the optimal code never spends more than 8 bits a character */
+/* on average, hence the bound above */
+size_t huff_encode(const char* s, size_t len, unsigned char* out) {
+	const unsigned char* p = (const unsigned char*)s;
+	uint32_t freq[256];
+	uint64_t code[256];
+	unsigned char clen[256];
+	huff_tree t;
+	bit_writer w;
+	size_t i;
+	histogram(s, len, freq);
+	flat_tree_maker(freq, &t);
+	flat_codes(&t, code, clen);
+	huff_canonical(clen, code);
+	put64(out, len);
+	memcpy(out + 16, clen, 256);
+	w.acc = 0;
+	w.n = 0;
+	w.out = out + HUFF_BLOCK_HEADER;
+	for (i = 0; i < len; i++)
+		put_bits(&w, code[p[i]], clen[p[i]]);
+	flush_bits(&w);
+	put64(out + 8, w.out - out - HUFF_BLOCK_HEADER);
+	return w.out - out;
+}
+
+uint64_t huff_block_size(const unsigned char* in) {
+	return get64(in);
+}
+
+/* canonical codes of length l run from first[l] to */
+/* first[l] + count[l] - 1 and decode to sym[index[l]] onwards */
+typedef struct canon canon;
+
+struct canon {
+	uint64_t first[HUFF_MAX_LEN + 1];
+	int count[HUFF_MAX_LEN + 1];
+	int index[HUFF_MAX_LEN + 1];
+	unsigned char sym[256];
+};
+
+/* one table entry resolves up to two characters that fit in */
+/* its HUFF_LOOKUP_BITS bits; nsym == 0 sends the decoder the slow way */
+typedef struct lookup lookup;
+
+struct lookup {
+	unsigned char sym[2];
+	unsigned char nsym;
+	unsigned char bits1;
+	unsigned char bits;
+};
+
+/* returns the number of coded characters, or -1 if the lengths */
+/* cannot form a prefix code */
+static int canon_init(canon* cn, const unsigned char* len) {
+	uint64_t c = 0;
+	int i, l, n = 0;
+	memset(cn->count, 0, sizeof(cn->count));
+	for (i = 0; i < 256; i++) {
+		if (len[i] > HUFF_MAX_LEN)
+			return -1;
+		cn->count[len[i]]++;
+	}
+	cn->count[0] = 0;
+	for (l = 1; l <= HUFF_MAX_LEN; l++) {
+		c = (c + cn->count[l-1]) << 1;
+		cn->first[l] = c;
+		cn->index[l] = n;
+		n += cn->count[l];
+		if (l < 64 && c + cn->count[l] > ((uint64_t)1 << l))
+			return -1;
+	}
+	for (i = 0; i < 256; i++)
+		if (len[i])
+			cn->sym[cn->index[len[i]]++] = i;
+	for (l = 1; l <= HUFF_MAX_LEN; l++)
+		cn->index[l] -= cn->count[l];
+	return n;
+}
+
+/* the character whose code is the top l bits of the */
+/* b-bit number v, for the smallest such l; 0 if none fits */
+static int canon_match(canon* cn, uint64_t v, int b, int* sym) {
+	int l;
+	for (l = 1; l <= b; l++) {
+		uint64_t c = v >> (b - l);
+		if (c - cn->first[l] < (uint64_t)cn->count[l]) {
+			*sym = cn->sym[cn->index[l] + (c - cn->first[l])];
+			return l;
+		}
+	}
+	return 0;
+}
+
+static void lookup_init(lookup* tab, canon* cn) {
+	int i, s, l1, l2;
+	for (i = 0; i < (1 << HUFF_LOOKUP_BITS); i++) {
+		tab[i].nsym = 0;
+		if (!(l1 = canon_match(cn, i, HUFF_LOOKUP_BITS, &s)))
+			continue;
+		tab[i].sym[0] = s;
+		tab[i].nsym = 1;
+		tab[i].bits1 = tab[i].bits = l1;
+		l2 = canon_match(cn, i & ((1 << (HUFF_LOOKUP_BITS - l1)) - 1),
+						 HUFF_LOOKUP_BITS - l1, &s);
+		if (l2) {
+			tab[i].sym[1] = s;
+			tab[i].nsym = 2;
+			tab[i].bits = l1 + l2;
+		}
+	}
+}
+
+/* the next unread bits sit at the top of acc, n of them valid */
+typedef struct bit_reader bit_reader;
+
+struct bit_reader {
+	uint64_t acc;
+	int n;
+	const unsigned char* p;
+	const unsigned char* end;
+	uint64_t used;
+};
+
+static void refill(bit_reader* r) {
+	if (r->p + 8 <= r->end) {
+		/* load a whole word; the bytes past n that it overlaps */
+		/* are the same ones the next load will bring in again */
+		r->acc |= get64(r->p) >> r->n;
+		r->p += (63 - r->n) >> 3;
+		r->n |= 56;
+		return;
+	}
+	while (r->n <= 56 && r->p < r->end) {
+		r->acc |= (uint64_t)(*r->p++) << (56 - r->n);
+		r->n += 8;
+	}
+	if (r->p == r->end)
+		r->n = 64; /* past the end reads as 0 bits */
+}
+
+static void consume(bit_reader* r, int b) {
+	r->acc <<= b;
+	r->n -= b;
+	r->used += b;
+}
+
+/* one bit at a time, for codes longer than the table resolves */
+static int slow_symbol(bit_reader* r, canon* cn) {
+	uint64_t c = 0;
+	int l;
+	for (l = 1; l <= HUFF_MAX_LEN; l++) {
+		if (r->n == 0)
+			refill(r);
+		c = (c << 1) | (r->acc >> 63);
+		consume(r, 1);
+		if (c - cn->first[l] < (uint64_t)cn->count[l])
+			return cn->sym[cn->index[l] + (c - cn->first[l])];
+	}
+	return -1;
+}
+
+size_t huff_decode(const unsigned char* in, size_t inlen, char* out) {
+	uint64_t raw, payload, i = 0;
+	int ncoded;
+	canon cn;
+	lookup tab[1 << HUFF_LOOKUP_BITS];
+	bit_reader r;
+	if (inlen < HUFF_BLOCK_HEADER)
+		return 0;
+	raw = get64(in);
+	payload = get64(in + 8);
+	if (payload > inlen - HUFF_BLOCK_HEADER)
+		return 0;
+	/* only an empty block may have no codes */
+	ncoded = canon_init(&cn, in + 16);
+	if (ncoded < 0 || (!ncoded && raw))
+		return 0;
+	lookup_init(tab, &cn);
+	r.acc = 0;
+	r.n = 0;
+	r.p = in + HUFF_BLOCK_HEADER;
+	r.end = r.p + payload;
+	r.used = 0;
+	while (i < raw) {
+		lookup* e;
+		if (r.n < 2 * HUFF_LOOKUP_BITS)
+			refill(&r);
+		e = &tab[r.acc >> (64 - HUFF_LOOKUP_BITS)];
+		if (e->nsym == 2 && i + 1 < raw) {
+			out[i++] = e->sym[0];
+			out[i++] = e->sym[1];
+			consume(&r, e->bits);
+		} else if (e->nsym) {
+			out[i++] = e->sym[0];
+			consume(&r, e->bits1);
+		} else {
+			int c = slow_symbol(&r, &cn);
+			if (c < 0)
+				return 0;
+			out[i++] = c;
+		}
+	}
+	if (r.used > payload * 8)
+		return 0;
+	return HUFF_BLOCK_HEADER + payload;
+}
+
+/* remember the offset of each block as it is written */
+static void index_add(uint64_t** offs, uint64_t* n, uint64_t off) {
+	if (!(*n & (*n - 1)))
+		*offs = realloc(*offs, sizeof(uint64_t) * (*n ? *n * 2 : 1));
+	(*offs)[(*n)++] = off;
+}
+
+/* the end marker, then the block index */
+static int write_trailer(FILE* out, uint64_t* offs, uint64_t n,
+						 uint64_t* nout) {
+	unsigned char b[8] = {0};
+	uint64_t i;
+	int rv = fwrite(b, 1, 8, out) != 8;
+	for (i = 0; i < n; i++) {
+		put64(b, offs[i]);
+		rv |= fwrite(b, 1, 8, out) != 8;
+	}
+	put64(b, n);
+	rv |= fwrite(b, 1, 8, out) != 8;
+	rv |= fwrite(HUFF_INDEX_MAGIC, 1, 4, out) != 4;
+	rv |= fflush(out) != 0;
+	*nout += 8 * (n + 2) + 4;
+	return rv ? -1 : 0;
+}
+
+int huff_compress_stream(FILE* in, FILE* out, uint64_t* nin, uint64_t* nout) {
+	char* buf = malloc(HUFF_BLOCK);
+	unsigned char* enc = malloc(huff_encode_bound(HUFF_BLOCK));
+	uint64_t* offs = NULL;
+	uint64_t nblocks = 0;
+	size_t n, m;
+	int rv = 0;
+	*nin = 0;
+	*nout = 4;
+	if (fwrite(HUFF_MAGIC, 1, 4, out) != 4)
+		rv = -1;
+	while (!rv && (n = fread(buf, 1, HUFF_BLOCK, in)) > 0) {
+		m = huff_encode(buf, n, enc);
+		if (fwrite(enc, 1, m, out) != m || fflush(out))
+			rv = -1;
+		index_add(&offs, &nblocks, *nout);
+		*nin += n;
+		*nout += m;
+	}
+	if (ferror(in) || write_trailer(out, offs, nblocks, nout))
+		rv = -1;
+	free(offs);
+	free(buf);
+	free(enc);
+	return rv;
+}
+
+int huff_decompress_stream(FILE* in, FILE* out, uint64_t* nin, uint64_t* nout) {
+	unsigned char* blk = NULL;
+	char* dec = NULL;
+	size_t blk_cap = 0, dec_cap = 0;
+	unsigned char head[16];
+	int rv = -1;
+	*nin = 4;
+	*nout = 0;
+	if (fread(head, 1, 4, in) != 4 || memcmp(head, HUFF_MAGIC, 4))
+		return -1;
+	while (fread(head, 1, 8, in) == 8) {
+		uint64_t raw = get64(head), size;
+		if (!raw) {
+			rv = 0;
+			break;
+		}
+		if (fread(head + 8, 1, 8, in) != 8)
+			break;
+		size = HUFF_BLOCK_HEADER + get64(head + 8);
+		if (size > blk_cap)
+			blk = realloc(blk, blk_cap = size);
+		if (raw > dec_cap)
+			dec = realloc(dec, dec_cap = raw);
+		if (!blk || !dec)
+			break;
+		memcpy(blk, head, 16);
+		if (fread(blk + 16, 1, size - 16, in) != size - 16
+			|| !huff_decode(blk, size, dec)
+			|| fwrite(dec, 1, raw, out) != raw || fflush(out))
+			break;
+		*nin += size;
+		*nout += raw;
+	}
+	*nin += 8;
+	free(blk);
+	free(dec);
+	return rv;
+}
+
+enum job_state { EMPTY, READY, BUSY, DONE };
+
+/* one block on its way through the pool; raw is the plain side */
+/* and enc the compressed side, whichever way the pool runs */
+typedef struct huff_job huff_job;
+
+struct huff_job {
+	enum job_state state;
+	uint64_t seq;
+	char* raw;
+	size_t nraw, raw_cap;
+	unsigned char* enc;
+	size_t nenc, enc_cap;
+	int err;
+};
+
+/* jobs is a ring of njobs slots: the main thread fills them in */
+/* order, workers take any READY slot, and the main thread writes */
+/* DONE slots out strictly in order, so the ring is the reorder buffer */
+typedef struct huff_pool huff_pool;
+
+struct huff_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+	huff_job* jobs;
+	int njobs;
+	int quit;
+	int compress;
+	int fd;
+	uint64_t* index;
+	uint64_t nblocks, end;
+};
+
+static void job_run(huff_pool* p, huff_job* j) {
+	uint64_t off, size, raw;
+	if (p->compress) {
+		j->nenc = huff_encode(j->raw, j->nraw, j->enc);
+		return;
+	}
+	/* a block runs up to the next block, or to the end marker */
+	off = p->index[j->seq];
+	size = (j->seq + 1 < p->nblocks ? p->index[j->seq + 1] : p->end) - off;
+	if (size < HUFF_BLOCK_HEADER || off + size > p->end) {
+		j->err = 1;
+		return;
+	}
+	if (size > j->enc_cap) {
+		unsigned char* enc = realloc(j->enc, size);
+		if (!enc) {
+			j->err = 1;
+			return;
+		}
+		j->enc = enc;
+		j->enc_cap = size;
+	}
+	if (pread(p->fd, j->enc, size, off) != (ssize_t)size) {
+		j->err = 1;
+		return;
+	}
+	/* an indexed file was cut into blocks of at most HUFF_BLOCK */
+	raw = huff_block_size(j->enc);
+	if (raw > HUFF_BLOCK) {
+		j->err = 1;
+		return;
+	}
+	if (raw > j->raw_cap) {
+		char* dec = realloc(j->raw, raw);
+		if (!dec) {
+			j->err = 1;
+			return;
+		}
+		j->raw = dec;
+		j->raw_cap = raw;
+	}
+	j->nraw = raw;
+	j->err = huff_decode(j->enc, size, j->raw) != size;
+}
+
+static void* worker(void* arg) {
+	huff_pool* p = arg;
+	pthread_mutex_lock(&p->lock);
+	while (1) {
+		huff_job* j = NULL;
+		int i;
+		for (i = 0; i < p->njobs; i++)
+			if (p->jobs[i].state == READY
+				&& (!j || p->jobs[i].seq < j->seq))
+				j = &p->jobs[i];
+		if (!j) {
+			if (p->quit)
+				break;
+			pthread_cond_wait(&p->work, &p->lock);
+			continue;
+		}
+		j->state = BUSY;
+		pthread_mutex_unlock(&p->lock);
+		job_run(p, j);
+		pthread_mutex_lock(&p->lock);
+		j->state = DONE;
+		pthread_cond_broadcast(&p->done);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+static void pool_post(huff_pool* p, huff_job* j, uint64_t seq) {
+	pthread_mutex_lock(&p->lock);
+	j->seq = seq;
+	j->err = 0;
+	j->state = READY;
+	pthread_cond_signal(&p->work);
+	pthread_mutex_unlock(&p->lock);
+}
+
+static void pool_wait(huff_pool* p, huff_job* j) {
+	pthread_mutex_lock(&p->lock);
+	while (j->state != DONE)
+		pthread_cond_wait(&p->done, &p->lock);
+	j->state = EMPTY;
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* run the main thread's side of the pool: read blocks in order */
+/* (compressing), hand them out, and write results back in order */
+static int pool_run(huff_pool* p, int nthreads, FILE* in, FILE* out,
+					uint64_t* nin, uint64_t* nout, uint64_t** offs) {
+	pthread_t* th = malloc(sizeof(pthread_t) * nthreads);
+	uint64_t next_read = 0, next_write = 0;
+	int i, rv = 0, eof = 0;
+	p->njobs = 2 * nthreads;
+	p->jobs = calloc(p->njobs, sizeof(huff_job));
+	if (!th || !p->jobs) {
+		free(th);
+		free(p->jobs);
+		return -1;
+	}
+	p->quit = 0;
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+	pthread_cond_init(&p->done, NULL);
+	/* run on as many threads as could be started */
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&th[i], NULL, worker, p))
+			break;
+	nthreads = i;
+	if (!nthreads)
+		rv = -1;
+	while (1) {
+		while (!eof && !rv && next_read - next_write < (uint64_t)p->njobs) {
+			huff_job* j = &p->jobs[next_read % p->njobs];
+			if (p->compress) {
+				if (!j->raw) {
+					j->raw = malloc(j->raw_cap = HUFF_BLOCK);
+					j->enc = malloc(j->enc_cap = huff_encode_bound(HUFF_BLOCK));
+					if (!j->raw || !j->enc) {
+						rv = -1;
+						break;
+					}
+				}
+				if (!(j->nraw = fread(j->raw, 1, HUFF_BLOCK, in))) {
+					eof = 1;
+					break;
+				}
+			} else if (next_read == p->nblocks) {
+				eof = 1;
+				break;
+			}
+			pool_post(p, j, next_read++);
+		}
+		if (next_write == next_read)
+			break;
+		huff_job* j = &p->jobs[next_write % p->njobs];
+		pool_wait(p, j);
+		next_write++;
+		if (rv || j->err) {
+			rv = -1;
+			continue;
+		}
+		if (p->compress) {
+			index_add(offs, &p->nblocks, *nout);
+			rv = -(fwrite(j->enc, 1, j->nenc, out) != j->nenc || fflush(out));
+			*nin += j->nraw;
+			*nout += j->nenc;
+		} else {
+			rv = -(fwrite(j->raw, 1, j->nraw, out) != j->nraw || fflush(out));
+			*nout += j->nraw;
+		}
+	}
+	pthread_mutex_lock(&p->lock);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->work);
+	pthread_mutex_unlock(&p->lock);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(th[i], NULL);
+	for (i = 0; i < p->njobs; i++) {
+		free(p->jobs[i].raw);
+		free(p->jobs[i].enc);
+	}
+	free(p->jobs);
+	free(th);
+	pthread_mutex_destroy(&p->lock);
+	pthread_cond_destroy(&p->work);
+	pthread_cond_destroy(&p->done);
+	return rv;
+}
+
+int huff_compress_stream_mt(FILE* in, FILE* out, int nthreads,
+							uint64_t* nin, uint64_t* nout) {
+	huff_pool p;
+	uint64_t* offs = NULL;
+	int rv;
+	if (nthreads <= 1)
+		return huff_compress_stream(in, out, nin, nout);
+	*nin = 0;
+	*nout = 4;
+	if (fwrite(HUFF_MAGIC, 1, 4, out) != 4)
+		return -1;
+	p.compress = 1;
+	p.nblocks = 0;
+	rv = pool_run(&p, nthreads, in, out, nin, nout, &offs);
+	if (ferror(in) || write_trailer(out, offs, p.nblocks, nout))
+		rv = -1;
+	free(offs);
+	return rv;
+}
+
+/* load the block index from the end of a seekable .huf file */
+static int read_index(int fd, huff_pool* p) {
+	unsigned char b[12];
+	off_t pos = lseek(fd, 0, SEEK_CUR);
+	off_t size = lseek(fd, 0, SEEK_END);
+	uint64_t i;
+	if (pos < 0 || size < 0)
+		return -1;
+	lseek(fd, pos, SEEK_SET);
+	if (size < 24 || pread(fd, b, 12, size - 12) != 12
+		|| memcmp(b + 8, HUFF_INDEX_MAGIC, 4))
+		return -1;
+	p->nblocks = get64(b);
+	if (p->nblocks > ((uint64_t)size - 24) / 8)
+		return -1;
+	p->end = size - 20 - 8 * p->nblocks;
+	p->index = malloc(sizeof(uint64_t) * (p->nblocks + 1));
+	if (!p->index)
+		return -1;
+	for (i = 0; i < p->nblocks; i++) {
+		if (pread(fd, b, 8, p->end + 8 + 8 * i) != 8
+			|| (p->index[i] = get64(b)) < 4) {
+			free(p->index);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int huff_decompress_stream_mt(FILE* in, FILE* out, int nthreads,
+							  uint64_t* nin, uint64_t* nout) {
+	huff_pool p;
+	unsigned char magic[4];
+	int rv;
+	p.fd = fileno(in);
+	if (nthreads <= 1 || read_index(p.fd, &p))
+		return huff_decompress_stream(in, out, nin, nout);
+	if (pread(p.fd, magic, 4, 0) != 4 || memcmp(magic, HUFF_MAGIC, 4)) {
+		free(p.index);
+		return -1;
+	}
+	*nin = p.end + 8 * (p.nblocks + 2) + 4;
+	*nout = 0;
+	p.compress = 0;
+	rv = pool_run(&p, nthreads, in, out, nin, nout, NULL);
+	free(p.index);
+	return rv;
+}
+
+/* Print the string's weight, the code of each of its characters */
+/* in character order, and its coding, all from the one tree */
+void fprint_code(FILE* out, const char* s) {
 	int i, len = strlen(s);
-	int* x = 0;
-	huff_list* hs = h_list(h_array(s, x), (*x));
-	huff* t = tree_maker(hs);
-	char* l;
+	uint32_t freq[256];
+	uint64_t code[256];
+	unsigned char clen[256];
+	huff_tree t;
+	int b, c;
+	histogram(s, len, freq);
+	flat_tree_maker(freq, &t);
+	flat_codes(&t, code, clen);
+	fprintf(out, "%d\n", len);
+	for (c = 0; c < 256; c++) {
+		if (!freq[c])
+			continue;
+		fprintf(out, "%c=", c);
+		for (b = clen[c] - 1; b >= 0; b--)
+			fputc('0' + ((code[c] >> b) & 1), out);
+		fputc('\n', out);
+	}
 	for (i = 0; i < len; i++) {
-		l = path_string(t,s[i]);
-		printf("%s", l);
+		c = (unsigned char)s[i];
+		for (b = clen[c] - 1; b >= 0; b--)
+			fputc('0' + ((code[c] >> b) & 1), out);
 	}
-	printf("\n");
-}
\ No newline at end of file
+	fputc('\n', out);
+}
+
+void print_code(char* s) {
+	fprint_code(stdout, s);
+}
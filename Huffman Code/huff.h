@@ -11,6 +11,10 @@
 #ifndef HUFF_H
 #define HUFF_H
 
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+
 typedef struct leaf leaf;
 typedef struct node node;
 typedef struct huff huff;
@@ -38,6 +42,29 @@ struct huff {
   union huff_union h;
 };
 
+/* A tree of n leaves can also be kept flat: leaves are nodes 0 to */
+/* n-1 in character order, the n-1 merged nodes follow in the order */
+/* they were made, and the root is node 2n-2. Children are 16-bit */
+/* indices into node, and leaf and merged weights are kept apart */
+typedef struct flat_node flat_node;
+
+struct flat_node {
+  uint16_t lsub;
+  uint16_t rsub;
+};
+
+#define FLAT_NONE 0xFFFF
+
+typedef struct huff_tree huff_tree;
+
+struct huff_tree {
+  int nleaves;
+  flat_node node[511];
+  unsigned char c[256];
+  int leaf_n[256];
+  int node_n[255];
+};
+
 typedef struct huff_list huff_list;
 
 struct huff_list {
@@ -45,6 +72,46 @@ struct huff_list {
   huff_list *next;
 };
 
+/* An arena hands out memory from large chunks and gives it all */
+/* back at once, so a tree costs no free per node. The first */
+/* chunk may be a buffer of the caller's, such as one on the stack */
+typedef struct arena_chunk arena_chunk;
+
+struct arena_chunk {
+  arena_chunk *next;
+  size_t size;
+  int owned;
+};
+
+typedef struct huff_arena huff_arena;
+
+struct huff_arena {
+  arena_chunk *first;
+  arena_chunk *cur;
+  size_t used;
+};
+
+/* huff and huff_list need no stricter alignment than this */
+#define ARENA_ALIGN 8
+#define ARENA_CHUNK (64 * 1024)
+
+/* Start an arena in the size bytes at buf (buf may be NULL) */
+void arena_init(huff_arena* a, void* buf, size_t size);
+
+/* n bytes from the arena, or NULL like malloc if memory is out */
+void* arena_alloc(huff_arena* a, size_t n);
+
+/* Take back everything allocated, keeping the chunks for reuse */
+void arena_reset(huff_arena* a);
+
+/* Give the chunks the arena had to malloc back to the system */
+void arena_release(huff_arena* a);
+
+/* From now on huff_singleton, merge, h_array and h_list on this */
+/* thread allocate from a, or from malloc if a is NULL; */
+/* returns the arena that was in use before */
+huff_arena* huff_use_arena(huff_arena* a);
+
 /* Here follow prototypes for a selection of functions you will likely
    want. You will need to write more, but this is a start.
  */ 
@@ -65,7 +132,11 @@ huff *merge(huff *h1, huff *h2);
 /* Essential for development and debugging. */
 void huff_show(huff *h);
 
+/* Count each byte of s (len bytes) into freq[256] in one pass */
+void histogram(const char* s, size_t len, uint32_t* freq);
+
 /* Given a string, makes an array of huff*/
+/* one leaf per distinct character, in character order */
 huff* h_array(char* s, int* n);
 
 /* Given an array of huff and its length*/
@@ -78,6 +149,28 @@ void merge_list(huff_list* hs);
 
 huff* tree_maker(huff_list *hs);
 
+/* Given a table of 256 character counts, build a Huffman tree */
+/* with a binary min-heap in O(n log n). Its codes are as short in */
+/* total as tree_maker's, but ties may be broken differently */
+/* characters with a count of 0 are left out; NULL if all are 0 */
+huff* heap_tree_maker(uint32_t* freq);
+
+/* Build the flat form of heap_tree_maker's tree into t; */
+/* returns the index of the root, or -1 if every count is 0 */
+int flat_tree_maker(uint32_t* freq, huff_tree* t);
+
+/* Return the weight of node i of a flat tree. */
+int flat_weight(huff_tree* t, int i);
+
+/* Display the flat tree under node i as huff_show would. */
+void flat_show(huff_tree* t, int i);
+
+/* Fill code[256] and len[256] from a flat tree, without recursion; */
+/* code[c] holds the len[c] bits of c's path, the last bit lowest; */
+/* characters not in the tree get length 0, and a tree of one */
+/* leaf gives it the one bit code 0 */
+void flat_codes(huff_tree* t, uint64_t* code, unsigned char* len);
+
 /* find the path of char in binary*/
 int path(huff* h, char c, int p);
 
@@ -88,7 +181,73 @@ char bit_puller(int b, int n);
 /* convert the binary number to string*/
 char* path_string(huff* h, char c);
 
-/* print out the string and its coding*/
+/* Longest code a tree can produce: a deeper tree would need */
+/* more characters than fit in the int counts of its leaves */
+#define HUFF_MAX_LEN 64
+
+/* Fill code[256] with canonical codes for the lengths len[256] */
+void huff_canonical(unsigned char* len, uint64_t* code);
+
+/* A compressed block is laid out as */
+/*   8 bytes  number of characters it decodes to */
+/*   8 bytes  number of payload bytes that follow the header */
+/*   256 bytes  canonical code length of every character */
+/*   payload  the codes packed most significant bit first */
+/* all numbers big-endian. A .huf file is HUFF_MAGIC, its blocks, */
+/* 8 zero bytes where the next block's length would be, and then */
+/* an index: the 8-byte file offset of every block, the number */
+/* of blocks in 8 bytes, and HUFF_INDEX_MAGIC */
+#define HUFF_MAGIC "HUF1"
+#define HUFF_INDEX_MAGIC "HUFI"
+#define HUFF_BLOCK_HEADER (16 + 256)
+
+/* Most bytes huff_encode can write for len characters */
+size_t huff_encode_bound(size_t len);
+
+/* Compress len characters of s into one block at out, which */
+/* must hold huff_encode_bound(len) bytes; returns bytes written */
+size_t huff_encode(const char* s, size_t len, unsigned char* out);
+
+/* Codes up to this long decode with a single table lookup */
+#define HUFF_LOOKUP_BITS 11
+
+/* Number of characters the block at in decodes to */
+uint64_t huff_block_size(const unsigned char* in);
+
+/* Decompress the block at in, of which inlen bytes are readable, */
+/* into out, which must hold huff_block_size(in) characters; */
+/* returns the bytes the block took up, or 0 if it is malformed */
+size_t huff_decode(const unsigned char* in, size_t inlen, char* out);
+
+/* Streams are cut into blocks of this many characters, each */
+/* with its own code, so memory use does not grow with the input */
+#define HUFF_BLOCK (128 * 1024)
+
+/* Compress in to out as a .huf stream, writing each block as */
+/* soon as it is encoded; the byte counts read and written go */
+/* to nin and nout. Returns 0, or -1 if a read or write failed */
+int huff_compress_stream(FILE* in, FILE* out, uint64_t* nin, uint64_t* nout);
+
+/* Decompress a .huf stream from in to out, block by block; */
+/* returns 0, or -1 if in is not a complete .huf stream */
+int huff_decompress_stream(FILE* in, FILE* out, uint64_t* nin, uint64_t* nout);
+
+/* As huff_compress_stream, with blocks encoded by nthreads */
+/* threads and written back in order */
+int huff_compress_stream_mt(FILE* in, FILE* out, int nthreads,
+							uint64_t* nin, uint64_t* nout);
+
+/* As huff_decompress_stream, with blocks decoded by nthreads */
+/* threads; in must be a seekable file ending in a block index, */
+/* anything else is decompressed on the calling thread */
+int huff_decompress_stream_mt(FILE* in, FILE* out, int nthreads,
+							  uint64_t* nin, uint64_t* nout);
+
+/* Print the string's weight, its code table and its coding, */
+/* all from one tree, to out */
+void fprint_code(FILE* out, const char* s);
+
+/* fprint_code to stdout */
 void print_code(char* s);
 
 #endif /* HUFF_H */
\ No newline at end of file
@@ -0,0 +1,218 @@
+/* Throughput benchmarks for huff.c */
+/* Each corpus is generated from a fixed seed, so runs are */
+/* comparable between releases. Every stage is timed on its own */
+/* and reported as one CSV line: */
+/*   corpus,stage,items,seconds,mb_per_s,ns_per_item,peak_rss_kb */
+/* items are bytes for histogram/encode/decode, and tree builds */
+/* for the tree stages. */
+/* usage: huff_bench [megabytes [out.csv]] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "huff.h"
+
+/* run each stage for at least this long */
+#define MIN_SECONDS 0.25
+
+static uint64_t seed;
+
+/* xorshift64*, so every platform sees the same corpora */
+static uint64_t rnd(void) {
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss(void) {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+static void gen_uniform(char* s, size_t len) {
+	size_t i;
+	for (i = 0; i < len; i++)
+		s[i] = rnd() >> 56;
+}
+
+/* letters drawn with probability 1/rank, most common first */
+static void gen_zipf(char* s, size_t len) {
+	const char* order = " etaoinshrdlcumwfgypbvkjxqz.,ETAOINSHRDLCUMWFGYPBVKJXQZ";
+	int n = strlen(order), i;
+	double cdf[64], total = 0;
+	size_t j;
+	for (i = 0; i < n; i++)
+		cdf[i] = (total += 1.0 / (i + 1));
+	for (j = 0; j < len; j++) {
+		double u = (rnd() >> 11) * (1.0 / 9007199254740992.0) * total;
+		for (i = 0; i < n - 1 && cdf[i] < u; i++)
+			;
+		s[j] = order[i];
+	}
+}
+
+/* the A-F and space alphabet of the original assignment */
+static void gen_hex(char* s, size_t len) {
+	const char* abc = "ABCDEF ";
+	size_t i;
+	for (i = 0; i < len; i++)
+		s[i] = abc[rnd() % 7];
+}
+
+/* long runs of a single character */
+static void gen_runs(char* s, size_t len) {
+	size_t i = 0;
+	while (i < len) {
+		size_t run = 1000 + rnd() % 100000;
+		char c = rnd() >> 56;
+		for (; run && i < len; run--)
+			s[i++] = c;
+	}
+}
+
+static void report(FILE* out, const char* corpus, const char* stage,
+				   double items, double secs, int bytes) {
+	char mb[32] = "";
+	if (bytes)
+		snprintf(mb, sizeof(mb), "%.1f", items / secs / 1e6);
+	fprintf(out, "%s,%s,%.0f,%.4f,%s,%.3f,%ld\n", corpus, stage, items, secs,
+			mb, secs / items * 1e9, peak_rss());
+	fflush(out);
+}
+
+static void bench_trees(FILE* out, const char* corpus, uint32_t* freq) {
+	huff_arena a;
+	huff_tree t;
+	double t0, secs;
+	long i, reps;
+	arena_init(&a, NULL, 0);
+	huff_use_arena(&a);
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++) {
+			heap_tree_maker(freq);
+			arena_reset(&a);
+		}
+		secs = now() - t0;
+	}
+	report(out, corpus, "tree_heap", reps / 2, secs, 0);
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++) {
+			/* one leaf per counted character, as h_array makes them */
+			huff* ha = arena_alloc(&a, sizeof(huff) * 256);
+			int c, n = 0;
+			for (c = 0; c < 256; c++) {
+				if (freq[c]) {
+					ha[n].tag = LEAF;
+					ha[n].h.leaf.c = c;
+					ha[n].h.leaf.n = freq[c];
+					n++;
+				}
+			}
+			tree_maker(h_list(ha, n));
+			arena_reset(&a);
+		}
+		secs = now() - t0;
+	}
+	report(out, corpus, "tree_list", reps / 2, secs, 0);
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			flat_tree_maker(freq, &t);
+		secs = now() - t0;
+	}
+	report(out, corpus, "tree_flat", reps / 2, secs, 0);
+	huff_use_arena(NULL);
+	arena_release(&a);
+}
+
+static void bench_corpus(FILE* out, const char* corpus, char* s, size_t len) {
+	size_t nblocks = (len + HUFF_BLOCK - 1) / HUFF_BLOCK, b, pos, enclen = 0;
+	unsigned char* enc = malloc(nblocks * huff_encode_bound(HUFF_BLOCK));
+	char* dec = malloc(len);
+	uint32_t freq[256];
+	double t0, secs;
+	long i, reps;
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			histogram(s, len, freq);
+		secs = now() - t0;
+	}
+	report(out, corpus, "histogram", (double)len * (reps / 2), secs, 1);
+	bench_trees(out, corpus, freq);
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			for (b = 0, pos = 0; b < nblocks; b++) {
+				size_t n = len - b * HUFF_BLOCK;
+				pos += huff_encode(s + b * HUFF_BLOCK,
+								   n < HUFF_BLOCK ? n : HUFF_BLOCK, enc + pos);
+			}
+		secs = now() - t0;
+		enclen = pos;
+	}
+	report(out, corpus, "encode", (double)len * (reps / 2), secs, 1);
+	for (reps = 1, secs = 0; secs < MIN_SECONDS; reps *= 2) {
+		t0 = now();
+		for (i = 0; i < reps; i++)
+			for (b = 0, pos = 0; b < nblocks; b++)
+				pos += huff_decode(enc + pos, enclen - pos,
+								   dec + b * HUFF_BLOCK);
+		secs = now() - t0;
+	}
+	report(out, corpus, "decode", (double)len * (reps / 2), secs, 1);
+	if (memcmp(s, dec, len))
+		fprintf(stderr, "%s: decoded data differs\n", corpus);
+	free(enc);
+	free(dec);
+}
+
+/* tree builders alone, on alphabets of n characters */
+static void bench_alphabet(FILE* out, int n) {
+	uint32_t freq[256] = {0};
+	char corpus[32];
+	int c;
+	for (c = 0; c < n; c++)
+		freq[c] = 1 + rnd() % 10000;
+	snprintf(corpus, sizeof(corpus), "alphabet%d", n);
+	bench_trees(out, corpus, freq);
+}
+
+int main(int argc, char* argv[]) {
+	size_t len = (argc > 1 ? atol(argv[1]) : 16) << 20;
+	FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+	char* s = malloc(len);
+	if (!out || !s) {
+		fprintf(stderr, "usage: %s [megabytes [out.csv]]\n", argv[0]);
+		return 1;
+	}
+	fprintf(out, "corpus,stage,items,seconds,mb_per_s,ns_per_item,peak_rss_kb\n");
+	seed = 0x9E3779B97F4A7C15ULL;
+	bench_alphabet(out, 6);
+	bench_alphabet(out, 64);
+	bench_alphabet(out, 256);
+	gen_uniform(s, len);
+	bench_corpus(out, "uniform", s, len);
+	gen_zipf(s, len);
+	bench_corpus(out, "zipf", s, len);
+	gen_hex(s, len);
+	bench_corpus(out, "hex", s, len);
+	gen_runs(s, len);
+	bench_corpus(out, "runs", s, len);
+	free(s);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
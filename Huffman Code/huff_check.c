@@ -0,0 +1,248 @@
+/* Round-trip checks for huff.c */
+/* Every case is encoded and decoded again, one block at a time */
+/* and as a whole .huf stream, serially and on a thread pool, and */
+/* must come back byte for byte; the code table print_code shows */
+/* must be the one its coding uses. Prints one line per failure and */
+/* exits non-zero if there was any. */
+/* usage: huff_check */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "huff.h"
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+static int failures;
+
+/* xorshift64*, so every run sees the same cases */
+static uint64_t rnd(void) {
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return seed * 2685821657736338717ULL;
+}
+
+static void fail(const char* name, const char* what) {
+	printf("%s: %s\n", name, what);
+	failures++;
+}
+
+/* longest code the encoder gives s, to show a case reaches past */
+/* the single lookup table */
+static int longest_code(const char* s, size_t len) {
+	uint32_t freq[256];
+	uint64_t code[256];
+	unsigned char clen[256];
+	huff_tree t;
+	int c, max = 0;
+	histogram(s, len, freq);
+	flat_tree_maker(freq, &t);
+	flat_codes(&t, code, clen);
+	for (c = 0; c < 256; c++)
+		if (clen[c] > max)
+			max = clen[c];
+	return max;
+}
+
+/* s as one block per HUFF_BLOCK, each decoded on its own */
+static void check_blocks(const char* name, const char* s, size_t len) {
+	size_t b, n;
+	unsigned char* enc = malloc(huff_encode_bound(HUFF_BLOCK));
+	char* dec = malloc(HUFF_BLOCK);
+	if (!enc || !dec) {
+		fail(name, "out of memory");
+		free(enc);
+		free(dec);
+		return;
+	}
+	for (b = 0; b == 0 || b < len; b += HUFF_BLOCK) {
+		size_t nenc;
+		n = len - b < HUFF_BLOCK ? len - b : HUFF_BLOCK;
+		nenc = huff_encode(s + b, n, enc);
+		if (huff_block_size(enc) != n)
+			fail(name, "block size in header differs");
+		else if (huff_decode(enc, nenc, dec) != nenc)
+			fail(name, "block did not decode");
+		else if (memcmp(dec, s + b, n))
+			fail(name, "block decoded to different bytes");
+		/* a block cut short must be refused, not read past */
+		else if (nenc > 16 && huff_decode(enc, nenc - 1, dec))
+			fail(name, "truncated block decoded");
+	}
+	free(enc);
+	free(dec);
+}
+
+/* s through the stream API on nthreads threads each way */
+static void check_stream(const char* name, const char* s, size_t len,
+						 int cthreads, int dthreads) {
+	FILE* in = tmpfile();
+	FILE* huf = tmpfile();
+	FILE* out = tmpfile();
+	uint64_t nin, nout;
+	char* dec = malloc(len + 1);
+	char what[64];
+	if (!in || !huf || !out || !dec) {
+		fail(name, dec ? "no temporary file" : "out of memory");
+		if (in)
+			fclose(in);
+		if (huf)
+			fclose(huf);
+		if (out)
+			fclose(out);
+		free(dec);
+		return;
+	}
+	fwrite(s, 1, len, in);
+	rewind(in);
+	snprintf(what, sizeof(what), "stream -j %d / -j %d", cthreads, dthreads);
+	if (huff_compress_stream_mt(in, huf, cthreads, &nin, &nout) || nin != len)
+		fail(name, what);
+	fflush(huf);
+	rewind(huf);
+	if (huff_decompress_stream_mt(huf, out, dthreads, &nin, &nout)
+		|| nout != len)
+		fail(name, what);
+	rewind(out);
+	if (fread(dec, 1, len + 1, out) != len || memcmp(dec, s, len))
+		fail(name, what);
+	fclose(in);
+	fclose(huf);
+	fclose(out);
+	free(dec);
+}
+
+static void check(const char* name, const char* s, size_t len) {
+	check_blocks(name, s, len);
+	check_stream(name, s, len, 1, 1);
+	check_stream(name, s, len, 3, 1);
+	check_stream(name, s, len, 1, 3);
+	check_stream(name, s, len, 3, 3);
+}
+
+/* fprint_code's table and coding of s must agree: the coding is */
+/* the table's code of every character of s in turn, and no code */
+/* is a prefix of another */
+static void check_print(const char* s) {
+	char table[256][80], line[4096], *bits;
+	FILE* f = tmpfile();
+	size_t len = strlen(s), i, at = 0;
+	int c, d, seen = 0;
+	if (!f) {
+		fail(s, "no temporary file");
+		return;
+	}
+	memset(table, 0, sizeof(table));
+	fprint_code(f, s);
+	rewind(f);
+	if (!fgets(line, sizeof(line), f) || strtoul(line, NULL, 10) != len) {
+		fail(s, "printed weight is not the length");
+		fclose(f);
+		return;
+	}
+	for (c = 0; c < 256; c++) {
+		if (!memchr(s, c, len))
+			continue;
+		if (!fgets(line, sizeof(line), f) || (unsigned char)line[0] != c
+			|| line[1] != '=' || strlen(line) < 4
+			|| strlen(line) - 3 >= sizeof(table[c])) {
+			fail(s, "table line missing or out of order");
+			fclose(f);
+			return;
+		}
+		line[strlen(line) - 1] = 0;
+		strcpy(table[c], line + 2);
+		seen++;
+	}
+	for (c = 0; c < 256; c++)
+		for (d = 0; d < 256 && seen > 1; d++)
+			if (c != d && table[c][0] && table[d][0]
+				&& !strncmp(table[c], table[d], strlen(table[c])))
+				fail(s, "one code is a prefix of another");
+	bits = malloc(len * 80 + 2);
+	if (!bits || !fgets(bits, len * 80 + 2, f)) {
+		fail(s, bits ? "coding missing" : "out of memory");
+		free(bits);
+		fclose(f);
+		return;
+	}
+	for (i = 0; i < len; i++) {
+		const char* code = table[(unsigned char)s[i]];
+		if (strncmp(bits + at, code, strlen(code))) {
+			fail(s, "coding does not use the printed table");
+			break;
+		}
+		at += strlen(code);
+	}
+	if (i == len && strcmp(bits + at, "\n"))
+		fail(s, "coding is longer than the table gives");
+	free(bits);
+	fclose(f);
+}
+
+int main(void) {
+	size_t max = 3 * HUFF_BLOCK, i, len;
+	char* s = malloc(max);
+	int c, k;
+	if (!s) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	/* nothing at all */
+	check("empty", "", 0);
+	/* a single character, alone and repeated past a block */
+	s[0] = 'x';
+	check("one byte", s, 1);
+	memset(s, 0, HUFF_BLOCK + 5);
+	check("one symbol", s, HUFF_BLOCK + 5);
+	/* every byte value once, then all of them at random, so the */
+	/* last block is shorter than HUFF_BLOCK */
+	for (c = 0; c < 256; c++)
+		s[c] = c;
+	check("all bytes once", s, 256);
+	len = 2 * HUFF_BLOCK + 12345;
+	for (i = 0; i < len; i++)
+		s[i] = rnd() >> 56;
+	check("all bytes random", s, len);
+	/* Fibonacci counts give the deepest trees: symbol k appears */
+	/* fib(k) times, so the rarest codes are about 25 bits long */
+	{
+		uint32_t a = 1, b = 1, t;
+		len = 0;
+		for (k = 0; k < 26; k++) {
+			for (i = 0; i < a && len < max; i++)
+				s[len++] = 'A' + k;
+			t = a + b;
+			a = b;
+			b = t;
+		}
+		for (i = len - 1; i > 0; i--) {
+			size_t j = rnd() % (i + 1);
+			char x = s[i];
+			s[i] = s[j];
+			s[j] = x;
+		}
+		if (longest_code(s, len) <= HUFF_LOOKUP_BITS)
+			fail("skewed", "codes fit the lookup table; case is too easy");
+		check("skewed", s, len);
+	}
+	/* the string mode's table against its coding, on the examples */
+	/* of huff.h and on strings with many equal counts */
+	check_print("AABBCDE");
+	check_print("HUBBUB");
+	check_print("REFEREE");
+	check_print("x");
+	check_print("");
+	for (k = 0; k < 2000; k++) {
+		int n = 1 + rnd() % 12;
+		len = 1 + rnd() % 60;
+		for (i = 0; i < len; i++)
+			s[i] = 'A' + rnd() % n;
+		s[len] = 0;
+		check_print(s);
+	}
+	free(s);
+	if (!failures)
+		printf("all round trips passed\n");
+	return failures != 0;
+}
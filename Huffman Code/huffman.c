@@ -6,19 +6,72 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include "huff.h"
 
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* open name, or use std for a missing name or "-" */
+static FILE* open_arg(int argc, char* argv[], int i, char* mode, FILE* std) {
+	FILE* f;
+	if (i >= argc || !strcmp(argv[i], "-"))
+		return std;
+	if (!(f = fopen(argv[i], mode))) {
+		fprintf(stderr, "Cannot open %s\n", argv[i]);
+		exit(1);
+	}
+	return f;
+}
+
+/* compress or decompress between files or stdin and stdout */
+static int stream(int argc, char* argv[], int compress) {
+	int a = 2, nthreads = 1;
+	FILE *in, *out;
+	uint64_t nin, nout;
+	double t;
+	int rv;
+	if (argc > 3 && !strcmp(argv[2], "-j")) {
+		nthreads = atoi(argv[3]);
+		a = 4;
+	}
+	in = open_arg(argc, argv, a, "rb", stdin);
+	out = open_arg(argc, argv, a + 1, "wb", stdout);
+	t = now();
+	rv = compress ? huff_compress_stream_mt(in, out, nthreads, &nin, &nout)
+		: huff_decompress_stream_mt(in, out, nthreads, &nin, &nout);
+	t = now() - t;
+	if (rv) {
+		fprintf(stderr, compress ? "Read or write failed\n"
+				: "Input is not a complete .huf stream\n");
+		return 1;
+	}
+	fprintf(stderr, "%llu -> %llu bytes (%.3f), %.1f MB/s\n",
+			(unsigned long long)nin, (unsigned long long)nout,
+			nin ? (double)nout / nin : 0.0,
+			t > 0 ? (compress ? nin : nout) / t / 1e6 : 0.0);
+	if (in != stdin)
+		fclose(in);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
-	int* x = 0;
-	huff_list* hs1 = h_list(h_array(argv[1], x), (*x));
-	huff_list* hs2 = h_list(h_array(argv[1], x), (*x));
-	huff* t = tree_maker(hs1);
-	printf("%d\n", huff_weight(t));
-	while (hs2) {
-		char c = hs2->val->h.leaf.c;
-		printf("%c=%s\n", c, path_string(t,c));
-		hs2 = hs2->next;
+	if (argc >= 2 && argc <= 6 && !strcmp(argv[1], "-c"))
+		return stream(argc, argv, 1);
+	if (argc >= 2 && argc <= 6 && !strcmp(argv[1], "-d"))
+		return stream(argc, argv, 0);
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s string\n"
+				"       %s -c [-j threads] [file|- [out.huf|-]]\n"
+				"       %s -d [-j threads] [file.huf|- [out|-]]\n", argv[0], argv[0], argv[0]);
+		return 1;
 	}
+	/* the table and the coding come from the same tree, so they agree */
 	print_code(argv[1]);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+// Frame-of-reference bit packing, after the getByte/replaceByte
+// and bitMask/logicalShift puzzles of bits.c: each value is shifted
+// into place and masked out again, 32 bits at a time.
+
+#include <string.h>
+#include "bitpack.h"
+#include "bits_generic.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* values per lane, and lanes per block */
+#define LANE_VALUES (BITPACK_BLOCK / 4)
+
+/* bitMask(w - 1, 0) that also covers w == 0 and w == 32 */
+static uint32_t low_bits(int w) {
+  return w ? ~(uint32_t)0 >> (32 - w) : 0;
+}
+
+size_t bitpack_bound(size_t n) {
+  return (n + BITPACK_BLOCK - 1) / BITPACK_BLOCK * (2 + BITPACK_BLOCK);
+}
+
+/* packs one full block of deltas d at width w into data */
+static void pack(const uint32_t* d, int w, uint32_t* data) {
+  int lane, t;
+  memset(data, 0, 4 * w * sizeof(uint32_t));
+  if (!w)
+    return;
+  for (lane = 0; lane < 4; lane++) {
+    int pos = 0;
+    for (t = 0; t < LANE_VALUES; t++, pos += w) {
+      uint32_t v = d[4 * t + lane];
+      int word = pos >> 5, off = pos & 31;
+      data[4 * word + lane] |= v << off;
+      if (off + w > 32)
+        data[4 * (word + 1) + lane] |= v >> (32 - off);
+    }
+  }
+}
+
+size_t bitpack_encode(const uint32_t* in, size_t n, uint32_t* out) {
+  uint32_t d[BITPACK_BLOCK];
+  size_t b, i, len, words = 0;
+  for (b = 0; b < n; b += BITPACK_BLOCK) {
+    uint32_t ref = in[b], max = in[b];
+    int w;
+    len = n - b < BITPACK_BLOCK ? n - b : BITPACK_BLOCK;
+    for (i = 1; i < len; i++) {
+      ref = in[b + i] < ref ? in[b + i] : ref;
+      max = in[b + i] > max ? in[b + i] : max;
+    }
+    w = how_many_bits(max - ref);
+    for (i = 0; i < len; i++)
+      d[i] = in[b + i] - ref;
+    for (; i < BITPACK_BLOCK; i++)
+      d[i] = 0;
+    out[words] = ref;
+    out[words + 1] = w;
+    pack(d, w, out + words + 2);
+    words += 2 + 4 * w;
+  }
+  return words;
+}
+
+/*
+ * The unpack loops are built for each width from 0 to 32 and fully
+ * unrolled, so every shift count and straddle is a constant.
+ */
+static inline __attribute__((always_inline))
+void unpack_scalar(const uint32_t* data, uint32_t ref, int w, uint32_t* out) {
+  uint32_t mask = low_bits(w);
+  int lane, t;
+  for (lane = 0; lane < 4; lane++) {
+    int pos = 0;
+#pragma GCC unroll 32
+    for (t = 0; t < LANE_VALUES; t++, pos += w) {
+      int word = pos >> 5, off = pos & 31;
+      uint32_t v = w ? data[4 * word + lane] >> off : 0;
+      if (off + w > 32)
+        v |= data[4 * (word + 1) + lane] << (32 - off);
+      out[4 * t + lane] = (v & mask) + ref;
+    }
+  }
+}
+
+#ifdef __SSE2__
+static inline __attribute__((always_inline))
+void unpack_sse2(const uint32_t* data, uint32_t ref, int w, uint32_t* out) {
+  const __m128i* in = (const __m128i*)data;
+  __m128i mask = _mm_set1_epi32(low_bits(w));
+  __m128i base = _mm_set1_epi32(ref);
+  int t, pos = 0;
+#pragma GCC unroll 32
+  for (t = 0; t < LANE_VALUES; t++, pos += w) {
+    int word = pos >> 5, off = pos & 31;
+    __m128i v = _mm_setzero_si128();
+    if (w)
+      v = _mm_srli_epi32(_mm_loadu_si128(in + word), off);
+    if (off + w > 32)
+      v = _mm_or_si128(v, _mm_slli_epi32(_mm_loadu_si128(in + word + 1),
+                                         32 - off));
+    v = _mm_add_epi32(_mm_and_si128(v, mask), base);
+    _mm_storeu_si128((__m128i*)out + t, v);
+  }
+}
+#define UNPACK unpack_sse2
+#else
+#define UNPACK unpack_scalar
+#endif
+
+#define W4(n) W(n) W(n + 1) W(n + 2) W(n + 3)
+
+static void unpack(const uint32_t* data, uint32_t ref, int w, uint32_t* out) {
+  switch (w) {
+#define W(n)                                    \
+  case n:                                       \
+    UNPACK(data, ref, n, out);                  \
+    break;
+    W4(0) W4(4) W4(8) W4(12) W4(16) W4(20) W4(24) W4(28) W(32)
+#undef W
+  }
+}
+
+size_t bitpack_decode(const uint32_t* in, size_t inlen, uint32_t* out,
+                      size_t n) {
+  uint32_t tail[BITPACK_BLOCK];
+  size_t b, words = 0;
+  for (b = 0; b < n; b += BITPACK_BLOCK) {
+    uint32_t w;
+    if (inlen - words < 2)
+      return 0;
+    w = in[words + 1];
+    if (w > 32 || inlen - words - 2 < 4 * w)
+      return 0;
+    if (n - b >= BITPACK_BLOCK) {
+      unpack(in + words + 2, in[words], w, out + b);
+    } else {
+      unpack(in + words + 2, in[words], w, tail);
+      memcpy(out + b, tail, (n - b) * sizeof(uint32_t));
+    }
+    words += 2 + 4 * w;
+  }
+  return words;
+}
@@ -0,0 +1,33 @@
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Frame-of-reference bit packing of uint32_t columns. Values go in
+ * blocks of BITPACK_BLOCK, each stored as
+ *   ref    the block's smallest value
+ *   width  bits per value, howManyBits of the largest value - ref
+ *   data   4 * width words of value - ref, width bits each
+ * with the values dealt round 4 interleaved lanes: value i goes in
+ * lane i % 4, and word k of a lane is data[4 * k + lane]. Each lane
+ * packs its 32 values from the low bit up, so one 4-wide shift and
+ * mask unpacks 4 consecutive values. A last block of fewer values is
+ * padded with ref.
+ */
+#define BITPACK_BLOCK 128
+
+/* Most words bitpack_encode can write for n values */
+size_t bitpack_bound(size_t n);
+
+/* Pack n values of in to out, which must hold bitpack_bound(n) */
+/* words; returns words written */
+size_t bitpack_encode(const uint32_t* in, size_t n, uint32_t* out);
+
+/* Unpack n values from the inlen words at in to out; returns the */
+/* words they took up, or 0 if in is short or malformed */
+size_t bitpack_decode(const uint32_t* in, size_t inlen, uint32_t* out,
+                      size_t n);
+
+#endif
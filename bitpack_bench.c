@@ -0,0 +1,129 @@
+// Throughput of bitpack_encode and bitpack_decode. Each column is
+// generated from a fixed seed: values of one width above a random
+// ref, for widths from 1 to 32, and a column whose blocks each have
+// a width of their own. Every stage runs for at least MIN_SECONDS
+// and is reported as one CSV line:
+//   column,stage,values,seconds,mvalues_per_s,mb_per_s,bits_per_value
+// mb_per_s counts the 4-byte values, packed or not, and
+// bits_per_value is the size of the packed column.
+// usage: bitpack_bench [values]
+//   built as gcc -O2 bitpack_bench.c bitpack.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bitpack.h"
+
+/* run each stage for at least this long */
+#define MIN_SECONDS 0.25
+
+static uint32_t seed = 2463534242u;
+
+/* xorshift32, so every run sees the same columns */
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* n values of ref plus random deltas of w bits */
+static void gen_width(uint32_t* col, size_t n, int w) {
+  uint32_t mask = ~(uint32_t)0 >> (32 - w);
+  uint32_t ref = w == 32 ? 0 : rnd() >> w;
+  size_t i;
+  for (i = 0; i < n; i++)
+    col[i] = ref + (rnd() & mask);
+}
+
+/* every block a random width from 0 to 32 and a ref of its own */
+static void gen_mixed(uint32_t* col, size_t n) {
+  size_t b, i;
+  for (b = 0; b < n; b += BITPACK_BLOCK) {
+    size_t len = n - b < BITPACK_BLOCK ? n - b : BITPACK_BLOCK;
+    int w = rnd() % 33;
+    uint32_t mask = w ? ~(uint32_t)0 >> (32 - w) : 0;
+    uint32_t ref = w == 32 ? 0 : rnd() >> w;
+    for (i = 0; i < len; i++)
+      col[b + i] = ref + (rnd() & mask);
+  }
+}
+
+static void report(const char* column, const char* stage, size_t n,
+                   long reps, double secs, size_t words) {
+  double values = (double)n * reps;
+  printf("%s,%s,%zu,%.4f,%.1f,%.1f,%.2f\n", column, stage, n, secs / reps,
+         values / secs / 1e6, values * 4 / secs / 1e6,
+         words * 32.0 / n);
+  fflush(stdout);
+}
+
+/* encode and decode of col, timed, after checking the round trip */
+static int bench(const char* column, const uint32_t* col, size_t n,
+                 uint32_t* enc, uint32_t* dec) {
+  size_t words = bitpack_encode(col, n, enc);
+  long reps, r;
+  double t0, secs;
+  if (bitpack_decode(enc, words, dec, n) != words ||
+      memcmp(col, dec, n * sizeof(uint32_t))) {
+    fprintf(stderr, "%s does not decode to itself\n", column);
+    return 1;
+  }
+  for (reps = 1;; reps *= 2) {
+    t0 = now();
+    for (r = 0; r < reps; r++)
+      bitpack_encode(col, n, enc);
+    if ((secs = now() - t0) >= MIN_SECONDS)
+      break;
+  }
+  report(column, "encode", n, reps, secs, words);
+  for (reps = 1;; reps *= 2) {
+    t0 = now();
+    for (r = 0; r < reps; r++)
+      bitpack_decode(enc, words, dec, n);
+    if ((secs = now() - t0) >= MIN_SECONDS)
+      break;
+  }
+  report(column, "decode", n, reps, secs, words);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  static const int widths[] = {1, 2, 4, 8, 12, 16, 20, 24, 28, 32};
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1 << 20;
+  uint32_t *col, *enc, *dec;
+  char name[32];
+  size_t i;
+  int rv = 0;
+  if (!n) {
+    fprintf(stderr, "usage: %s [values]\n", argv[0]);
+    return 1;
+  }
+  col = malloc(n * sizeof(uint32_t));
+  dec = malloc(n * sizeof(uint32_t));
+  enc = malloc(bitpack_bound(n) * sizeof(uint32_t));
+  if (!col || !dec || !enc) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  printf("column,stage,values,seconds,mvalues_per_s,mb_per_s,"
+         "bits_per_value\n");
+  for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    gen_width(col, n, widths[i]);
+    snprintf(name, sizeof(name), "width%d", widths[i]);
+    rv |= bench(name, col, n, enc, dec);
+  }
+  gen_mixed(col, n);
+  rv |= bench("mixed", col, n, enc, dec);
+  free(col);
+  free(dec);
+  free(enc);
+  return rv;
+}
@@ -0,0 +1,182 @@
+// Checks bitpack.c against the layout bitpack.h describes. Columns of
+// every width from 0 to 32, of lengths on either side of a block, and
+// of mixed widths per block are packed by bitpack_encode and by a
+// plain packer written from the header's description; the two must
+// give the same words, and bitpack_decode must give the column back
+// without writing past it. Encoded streams cut short or with a bad
+// width must be refused.
+// Prints the first bad column of every check that fails and exits
+// non-zero if any does.
+// usage: bitpack_check
+//   built as gcc -O2 bitpack_check.c bitpack.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitpack.h"
+
+/* random columns per width, and blocks in each mixed column */
+#define COLUMNS 64
+#define MIXED_BLOCKS 300
+
+static int failures;
+
+static void fail(const char* what, const char* column, size_t n, size_t at,
+                 uint32_t got, uint32_t want) {
+  printf("%s of %s (%zu values) at %zu: 0x%08x, want 0x%08x\n", what,
+         column, n, at, got, want);
+  failures++;
+}
+
+static uint32_t seed = 2463534242u;
+
+/* xorshift32, so every run sees the same inputs */
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static int ref_width(uint32_t d) {
+  int w = 0;
+  for (; d; d >>= 1)
+    w++;
+  return w;
+}
+
+/* the layout of bitpack.h, one bit at a time: ref, width, then bit */
+/* j of value i at bit j of lane i % 4's bit stream, whose word k is */
+/* data[4 * k + lane]; short blocks padded with ref */
+static size_t ref_encode(const uint32_t* in, size_t n, uint32_t* out) {
+  size_t b, i, words = 0;
+  for (b = 0; b < n; b += BITPACK_BLOCK) {
+    size_t len = n - b < BITPACK_BLOCK ? n - b : BITPACK_BLOCK;
+    uint32_t ref = in[b], max = in[b], *data = out + words + 2;
+    int w, j;
+    for (i = 1; i < len; i++) {
+      if (in[b + i] < ref)
+        ref = in[b + i];
+      if (in[b + i] > max)
+        max = in[b + i];
+    }
+    w = ref_width(max - ref);
+    memset(data, 0, 4 * w * sizeof(uint32_t));
+    for (i = 0; i < BITPACK_BLOCK; i++) {
+      uint32_t d = i < len ? in[b + i] - ref : 0;
+      size_t lane = i % 4, bit = i / 4 * w;
+      for (j = 0; j < w; j++, bit++)
+        data[4 * (bit / 32) + lane] |= (d >> j & 1) << (bit % 32);
+    }
+    out[words] = ref;
+    out[words + 1] = w;
+    words += 2 + 4 * w;
+  }
+  return words;
+}
+
+/* space for the longest column, with a guard word past the outputs */
+static uint32_t col[MIXED_BLOCKS * BITPACK_BLOCK];
+static uint32_t got[MIXED_BLOCKS * BITPACK_BLOCK + 1];
+static uint32_t enc[MIXED_BLOCKS * (2 + BITPACK_BLOCK) + 1];
+static uint32_t want[MIXED_BLOCKS * (2 + BITPACK_BLOCK)];
+
+#define GUARD 0xDEADBEEFu
+
+/* in[0..n) through encode and decode against ref_encode, and the */
+/* short and malformed streams decode must refuse */
+static void check_column(const char* name, const uint32_t* in, size_t n) {
+  size_t words, wwords, i, bound = bitpack_bound(n);
+  int before = failures;
+  enc[bound] = GUARD;
+  words = bitpack_encode(in, n, enc);
+  wwords = ref_encode(in, n, want);
+  if (enc[bound] != GUARD)
+    fail("encode past its bound", name, n, bound, enc[bound], GUARD);
+  if (words > bound)
+    fail("encoded words over the bound", name, n, 0, words, bound);
+  if (words != wwords)
+    fail("encoded words", name, n, 0, words, wwords);
+  for (i = 0; i < words && i < wwords; i++)
+    if (enc[i] != want[i]) {
+      fail("encoded word", name, n, i, enc[i], want[i]);
+      break;
+    }
+  got[n] = GUARD;
+  i = bitpack_decode(enc, words, got, n);
+  if (i != words)
+    fail("decoded words", name, n, 0, i, words);
+  if (got[n] != GUARD)
+    fail("decode past n", name, n, n, got[n], GUARD);
+  for (i = 0; i < n; i++)
+    if (got[i] != in[i]) {
+      fail("decoded value", name, n, i, got[i], in[i]);
+      break;
+    }
+  if (n && bitpack_decode(enc, words - 1, got, n))
+    fail("decode of a stream one word short", name, n, 0, 1, 0);
+  if (n) {
+    uint32_t w = enc[1];
+    enc[1] = 33;
+    if (bitpack_decode(enc, words, got, n))
+      fail("decode of width 33", name, n, 0, 1, 0);
+    enc[1] = w;
+  }
+  if (failures != before)
+    printf("  %s\n", name);
+}
+
+/* n values of ref plus deltas of exactly w bits, the widest of them */
+/* at a random place so every block has width w */
+static void fill(uint32_t* in, size_t n, int w, uint32_t ref) {
+  uint32_t mask = w ? ~(uint32_t)0 >> (32 - w) : 0;
+  size_t i;
+  for (i = 0; i < n; i++)
+    in[i] = ref + (rnd() & mask);
+  for (i = 0; i < n; i += BITPACK_BLOCK)
+    in[i + rnd() % (n - i < BITPACK_BLOCK ? n - i : BITPACK_BLOCK)] =
+        ref + mask;
+}
+
+int main(void) {
+  /* either side of one and two blocks, and a few blocks and a bit */
+  static const size_t lens[] = {1, 2, 3, 4, 5, 31, 127, 128, 129,
+                                255, 256, 257, 1000};
+  char name[64];
+  size_t l, i, n;
+  int w, c;
+  check_column("an empty column", col, 0);
+  for (w = 0; w <= 32; w++)
+    for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+      n = lens[l];
+      for (c = 0; c < COLUMNS / 8; c++) {
+        /* refs at 0, at the top, so the largest value is 2^32 - 1, */
+        /* and at random */
+        uint32_t top = w ? ~(~(uint32_t)0 >> (32 - w)) : ~(uint32_t)0;
+        uint32_t ref = c == 0 ? 0 : c == 1 ? top : rnd() & top;
+        fill(col, n, w, ref);
+        snprintf(name, sizeof(name), "width %d, ref 0x%08x", w, ref);
+        check_column(name, col, n);
+      }
+    }
+  /* each block its own width and ref, including descending values */
+  for (c = 0; c < COLUMNS; c++) {
+    n = MIXED_BLOCKS * BITPACK_BLOCK - rnd() % BITPACK_BLOCK;
+    for (i = 0; i < n; i += BITPACK_BLOCK) {
+      size_t len = n - i < BITPACK_BLOCK ? n - i : BITPACK_BLOCK;
+      w = rnd() % 33;
+      fill(col + i, len, w, w == 32 ? 0 : rnd() >> w);
+    }
+    if (c & 1)
+      for (i = 0; i < n; i++)
+        col[i] = ~col[i];
+    snprintf(name, sizeof(name), "mixed column %d", c);
+    check_column(name, col, n);
+  }
+  if (failures) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -3,6 +3,8 @@
 // the explicitly allowed ones. Complete the function using the 
 // the minimum number of bitwise operations. 
 
+#include "bits.h"
+
 /*
  * anyOddBit - return 1 if any odd-numbered bit in word set to 1
  *   Examples anyOddBit(0x5) = 0, anyOddBit(0x7) = 1
@@ -0,0 +1,83 @@
+#ifndef BITS_H
+#define BITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* bits.c needs a 32-bit int and x >> n to copy the sign bit, which */
+/* C leaves to the implementation; stop the build anywhere else */
+_Static_assert(sizeof(int) == 4, "bits.c needs a 32-bit int");
+_Static_assert((-1 >> 1) == -1 && (-8 >> 2) == -2,
+               "bits.c needs >> on signed ints to be arithmetic");
+
+/* The one-word puzzles of bits.c */
+int anyOddBit(int x);
+int bang(int x);
+int bitCount(int x);
+int bitMask(int highbit, int lowbit);
+int bitParity(int x);
+int getByte(int x, int n);
+int howManyBits(int x);
+int isAsciiDigit(int x);
+int isEqual(int x, int y);
+int isGreater(int x, int y);
+int isLessOrEqual(int x, int y);
+int isNonNegative(int x);
+int isNotEqual(int x, int y);
+int leftBitCount(int x);
+int logicalShift(int x, int n);
+int rempwr2(int x, int n);
+int replaceByte(int x, int n, int c);
+int rotateRight(int x, int n);
+int satMul3(int x);
+int subOK(int x, int y);
+
+/*
+ * The same results as bitCount, leftBitCount and howManyBits, from
+ * POPCNT and LZCNT on CPUs that have them (bits_fast.c)
+ */
+int fastBitCount(int x);
+int fastLeftBitCount(int x);
+int fastHowManyBits(int x);
+
+/*
+ * Batch versions, in bits_batch.c: out[i] = f(x[i]) or f(x[i], y[i])
+ * for i < n, with the same result as the one-word function on every
+ * input. Shift counts, byte numbers and the replacement byte are the
+ * same for the whole batch. out may be the same array as x or y.
+ */
+void anyOddBitBatch(const int32_t* x, int32_t* out, size_t n);
+void bangBatch(const int32_t* x, int32_t* out, size_t n);
+void bitCountBatch(const int32_t* x, int32_t* out, size_t n);
+void bitMaskBatch(const int32_t* highbit, const int32_t* lowbit,
+                  int32_t* out, size_t n);
+void bitParityBatch(const int32_t* x, int32_t* out, size_t n);
+void getByteBatch(const int32_t* x, int byte, int32_t* out, size_t n);
+void howManyBitsBatch(const int32_t* x, int32_t* out, size_t n);
+void isAsciiDigitBatch(const int32_t* x, int32_t* out, size_t n);
+void isEqualBatch(const int32_t* x, const int32_t* y, int32_t* out, size_t n);
+void isGreaterBatch(const int32_t* x, const int32_t* y, int32_t* out,
+                    size_t n);
+void isLessOrEqualBatch(const int32_t* x, const int32_t* y, int32_t* out,
+                        size_t n);
+void isNonNegativeBatch(const int32_t* x, int32_t* out, size_t n);
+void isNotEqualBatch(const int32_t* x, const int32_t* y, int32_t* out,
+                     size_t n);
+void leftBitCountBatch(const int32_t* x, int32_t* out, size_t n);
+void logicalShiftBatch(const int32_t* x, int shift, int32_t* out, size_t n);
+void rempwr2Batch(const int32_t* x, int power, int32_t* out, size_t n);
+void replaceByteBatch(const int32_t* x, int byte, int c, int32_t* out,
+                      size_t n);
+void rotateRightBatch(const int32_t* x, int shift, int32_t* out, size_t n);
+void satMul3Batch(const int32_t* x, int32_t* out, size_t n);
+void subOKBatch(const int32_t* x, const int32_t* y, int32_t* out, size_t n);
+
+/*
+ * batchLanes(4) runs the batches on 4 lanes even where the CPU has 8;
+ * batchLanes(0) goes back to the widest. Returns the lanes they now
+ * run on. Only for checking both loops on one machine: no batch may
+ * be running while it is called.
+ */
+int batchLanes(int n);
+
+#endif
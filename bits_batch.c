@@ -0,0 +1,213 @@
+// Array-at-a-time versions of the bits.c puzzles. Each body lives
+// once in bits_kernels.h and is built here three times: on one int,
+// on 4 ints (SSE2, or the generic vector code of other targets) and
+// on 8 ints for CPUs with AVX2, which also shifts each lane by its
+// own count. A batch runs the widest loop the CPU supports and
+// finishes the last few values one at a time.
+
+#include <pthread.h>
+#include <string.h>
+#include "bits.h"
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef int v8si __attribute__((vector_size(32)));
+
+#define KT int
+#define K(name) name##1
+#define KATTR
+#include "bits_kernels.h"
+#undef KT
+#undef K
+#undef KATTR
+
+#define KT v4si
+#define K(name) name##4
+#define KATTR
+#include "bits_kernels.h"
+#undef KT
+#undef K
+#undef KATTR
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_AVX2_LOOPS
+#define KT v8si
+#define K(name) name##8
+#define KATTR __attribute__((target("avx2")))
+#include "bits_kernels.h"
+#undef KT
+#undef K
+#undef KATTR
+#endif
+
+/* the widest lanes this CPU runs, and the lanes the batches run on */
+static int widest, w;
+static pthread_once_t lanes_once = PTHREAD_ONCE_INIT;
+
+static void lanes_detect(void) {
+#ifdef HAVE_AVX2_LOOPS
+  widest = __builtin_cpu_supports("avx2") ? 8 : 4;
+#else
+  widest = 4;
+#endif
+  w = widest;
+}
+
+/* 8 or 4: the widest, unless batchLanes chose 4 */
+static int lanes(void) {
+  pthread_once(&lanes_once, lanes_detect);
+  return w;
+}
+
+int batchLanes(int n) {
+  pthread_once(&lanes_once, lanes_detect);
+  w = n == 4 ? 4 : widest;
+  return w;
+}
+
+/*
+ * UNARY, BINARY and SCALAR define f##Batch for kernels f of one
+ * array, two arrays, or one array and fixed ints. f##Loop4 and
+ * f##Loop8 run the kernel on 4 or 8 lanes loaded from x (and y)
+ * without any alignment, and finish the tail with the int kernel.
+ */
+#define LOAD(v, p) memcpy(&(v), (p), sizeof(v))
+#define UNPAREN(...) __VA_ARGS__
+
+#define UNARY(f)                                                        \
+  static void f##Loop4(const int32_t* x, int32_t* out, size_t n) {      \
+    size_t i;                                                           \
+    for (i = 0; i + 4 <= n; i += 4) {                                   \
+      v4si a;                                                           \
+      LOAD(a, x + i);                                                   \
+      a = f##4(a);                                                      \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i]);                                              \
+  }                                                                     \
+  UNARY8(f)                                                             \
+  void f##Batch(const int32_t* x, int32_t* out, size_t n) {             \
+    DISPATCH8(f##Loop8(x, out, n));                                     \
+    f##Loop4(x, out, n);                                                \
+  }
+
+#define BINARY(f)                                                       \
+  static void f##Loop4(const int32_t* x, const int32_t* y, int32_t* out, \
+                       size_t n) {                                      \
+    size_t i;                                                           \
+    for (i = 0; i + 4 <= n; i += 4) {                                   \
+      v4si a, b;                                                        \
+      LOAD(a, x + i);                                                   \
+      LOAD(b, y + i);                                                   \
+      a = f##4(a, b);                                                   \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i], y[i]);                                        \
+  }                                                                     \
+  BINARY8(f)                                                            \
+  void f##Batch(const int32_t* x, const int32_t* y, int32_t* out,       \
+                size_t n) {                                             \
+    DISPATCH8(f##Loop8(x, y, out, n));                                  \
+    f##Loop4(x, y, out, n);                                             \
+  }
+
+/* x and the same one or two ints in every lane: PARAMS declares */
+/* them in parentheses and the rest of the arguments name them */
+#define SCALAR(f, PARAMS, ...)                                          \
+  static void f##Loop4(const int32_t* x, UNPAREN PARAMS, int32_t* out,  \
+                       size_t n) {                                      \
+    size_t i;                                                           \
+    for (i = 0; i + 4 <= n; i += 4) {                                   \
+      v4si a;                                                           \
+      LOAD(a, x + i);                                                   \
+      a = f##4(a, __VA_ARGS__);                                         \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i], __VA_ARGS__);                                 \
+  }                                                                     \
+  SCALAR8(f, PARAMS, __VA_ARGS__)                                       \
+  void f##Batch(const int32_t* x, UNPAREN PARAMS, int32_t* out, size_t n) { \
+    DISPATCH8(f##Loop8(x, __VA_ARGS__, out, n));                        \
+    f##Loop4(x, __VA_ARGS__, out, n);                                   \
+  }
+
+#ifdef HAVE_AVX2_LOOPS
+#define DISPATCH8(call)                                                 \
+  if (lanes() == 8) {                                                   \
+    call;                                                               \
+    return;                                                             \
+  }
+
+#define UNARY8(f)                                                       \
+  __attribute__((target("avx2")))                                       \
+  static void f##Loop8(const int32_t* x, int32_t* out, size_t n) {      \
+    size_t i;                                                           \
+    for (i = 0; i + 8 <= n; i += 8) {                                   \
+      v8si a;                                                           \
+      LOAD(a, x + i);                                                   \
+      a = f##8(a);                                                      \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i]);                                              \
+  }
+
+#define BINARY8(f)                                                      \
+  __attribute__((target("avx2")))                                       \
+  static void f##Loop8(const int32_t* x, const int32_t* y, int32_t* out, \
+                       size_t n) {                                      \
+    size_t i;                                                           \
+    for (i = 0; i + 8 <= n; i += 8) {                                   \
+      v8si a, b;                                                        \
+      LOAD(a, x + i);                                                   \
+      LOAD(b, y + i);                                                   \
+      a = f##8(a, b);                                                   \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i], y[i]);                                        \
+  }
+
+#define SCALAR8(f, PARAMS, ...)                                         \
+  __attribute__((target("avx2")))                                       \
+  static void f##Loop8(const int32_t* x, UNPAREN PARAMS, int32_t* out,  \
+                       size_t n) {                                      \
+    size_t i;                                                           \
+    for (i = 0; i + 8 <= n; i += 8) {                                   \
+      v8si a;                                                           \
+      LOAD(a, x + i);                                                   \
+      a = f##8(a, __VA_ARGS__);                                         \
+      memcpy(out + i, &a, sizeof(a));                                   \
+    }                                                                   \
+    for (; i < n; i++)                                                  \
+      out[i] = f##1(x[i], __VA_ARGS__);                                 \
+  }
+#else
+#define DISPATCH8(call)
+#define UNARY8(f)
+#define BINARY8(f)
+#define SCALAR8(f, PARAMS, ...)
+#endif
+
+UNARY(anyOddBit)
+UNARY(bang)
+UNARY(bitCount)
+BINARY(bitMask)
+UNARY(bitParity)
+SCALAR(getByte, (int byte), byte)
+UNARY(howManyBits)
+UNARY(isAsciiDigit)
+BINARY(isEqual)
+BINARY(isGreater)
+BINARY(isLessOrEqual)
+UNARY(isNonNegative)
+BINARY(isNotEqual)
+UNARY(leftBitCount)
+SCALAR(logicalShift, (int shift), shift)
+SCALAR(rempwr2, (int power), power)
+SCALAR(replaceByte, (int byte, int c), byte, c)
+SCALAR(rotateRight, (int shift), shift)
+UNARY(satMul3)
+BINARY(subOK)
@@ -0,0 +1,147 @@
+// Cost per call of every bits.c puzzle, and of the bits_fast.c and
+// bits_batch.c versions of the functions that have them. Prints one
+// CSV line per function and variant:
+//   function,variant,calls,ns_per_call,cycles_per_call
+// cycles come from the time stamp counter, so they are empty off x86
+// and follow the TSC rate rather than the core clock under turbo.
+// usage: bits_bench [calls]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bits.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+/* inputs are cycled through in pieces of this many values */
+#define CHUNK 4096
+
+static int32_t in[CHUNK], in2[CHUNK], out[CHUNK];
+/* every result is added in, so no call can be dropped */
+static volatile int sink;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long ticks(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void report(const char* f, const char* variant, long calls,
+                   double secs, unsigned long long cycles) {
+  char cyc[32] = "";
+#ifdef HAVE_TSC
+  snprintf(cyc, sizeof(cyc), "%.2f", (double)cycles / calls);
+#endif
+  (void)cycles;
+  printf("%s,%s,%ld,%.3f,%s\n", f, variant, calls, secs / calls * 1e9, cyc);
+}
+
+static void bench_one(const char* f, const char* variant, int (*fn)(int),
+                      long calls) {
+  long i, j;
+  int acc = 0;
+  double t0 = now();
+  unsigned long long c0 = ticks();
+  for (i = 0; i < calls; i += CHUNK)
+    for (j = 0; j < CHUNK; j++)
+      acc += fn(in[j]);
+  report(f, variant, calls, now() - t0, ticks() - c0);
+  sink = acc;
+}
+
+static void bench_two(const char* f, int (*fn)(int, int), long calls) {
+  long i, j;
+  int acc = 0;
+  double t0 = now();
+  unsigned long long c0 = ticks();
+  for (i = 0; i < calls; i += CHUNK)
+    for (j = 0; j < CHUNK; j++)
+      acc += fn(in[j], in2[j]);
+  report(f, "puzzle", calls, now() - t0, ticks() - c0);
+  sink = acc;
+}
+
+/* the functions with a shift or byte number, at a fixed one */
+static int getByte2(int x) { return getByte(x, 2); }
+static int logicalShift7(int x) { return logicalShift(x, 7); }
+static int rempwr2_5(int x) { return rempwr2(x, 5); }
+static int replaceByte1(int x) { return replaceByte(x, 1, 0xAB); }
+static int rotateRight13(int x) { return rotateRight(x, 13); }
+/* bitMask is only defined for bit numbers below 32 */
+static int bitMaskLow(int x, int y) { return bitMask(x & 31, y & 31); }
+
+static void bench_batch(const char* f,
+                        void (*fn)(const int32_t*, int32_t*, size_t),
+                        long calls) {
+  long i;
+  int acc = 0;
+  double t0 = now();
+  unsigned long long c0 = ticks();
+  for (i = 0; i < calls; i += CHUNK) {
+    fn(in, out, CHUNK);
+    acc += out[i / CHUNK % CHUNK];
+  }
+  report(f, "batch", calls, now() - t0, ticks() - c0);
+  sink = acc;
+}
+
+int main(int argc, char* argv[]) {
+  long calls = argc > 1 ? atol(argv[1]) : 1L << 26;
+  unsigned x = 2463534242u;
+  int i;
+  if (calls < CHUNK) {
+    fprintf(stderr, "usage: %s [calls >= %d]\n", argv[0], CHUNK);
+    return 1;
+  }
+  calls -= calls % CHUNK;
+  /* xorshift32, so every run sees the same inputs */
+  for (i = 0; i < CHUNK; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    in[i] = x;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    /* half equal to x, so the comparisons take both ways */
+    in2[i] = i & 1 ? (int32_t)x : in[i];
+  }
+  printf("function,variant,calls,ns_per_call,cycles_per_call\n");
+  bench_one("bitCount", "puzzle", bitCount, calls);
+  bench_one("bitCount", "fast", fastBitCount, calls);
+  bench_batch("bitCount", bitCountBatch, calls);
+  bench_one("leftBitCount", "puzzle", leftBitCount, calls);
+  bench_one("leftBitCount", "fast", fastLeftBitCount, calls);
+  bench_batch("leftBitCount", leftBitCountBatch, calls);
+  bench_one("howManyBits", "puzzle", howManyBits, calls);
+  bench_one("howManyBits", "fast", fastHowManyBits, calls);
+  bench_batch("howManyBits", howManyBitsBatch, calls);
+  bench_one("anyOddBit", "puzzle", anyOddBit, calls);
+  bench_one("bang", "puzzle", bang, calls);
+  bench_two("bitMask", bitMaskLow, calls);
+  bench_one("bitParity", "puzzle", bitParity, calls);
+  bench_one("getByte", "puzzle", getByte2, calls);
+  bench_one("isAsciiDigit", "puzzle", isAsciiDigit, calls);
+  bench_two("isEqual", isEqual, calls);
+  bench_two("isGreater", isGreater, calls);
+  bench_two("isLessOrEqual", isLessOrEqual, calls);
+  bench_one("isNonNegative", "puzzle", isNonNegative, calls);
+  bench_two("isNotEqual", isNotEqual, calls);
+  bench_one("logicalShift", "puzzle", logicalShift7, calls);
+  bench_one("rempwr2", "puzzle", rempwr2_5, calls);
+  bench_one("replaceByte", "puzzle", replaceByte1, calls);
+  bench_one("rotateRight", "puzzle", rotateRight13, calls);
+  bench_one("satMul3", "puzzle", satMul3, calls);
+  bench_two("subOK", subOK, calls);
+  return 0;
+}
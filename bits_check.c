@@ -0,0 +1,420 @@
+// Checks the bits.c puzzles, and the bits_fast.c versions, against
+// plain C versions of what each should compute. The functions of one
+// int are run on all 2^32 inputs, split over threads; those of two
+// ints on random pairs and on pairs of edge values, and those with a
+// shift, byte or power on random words and every count they allow.
+// Every bits_batch.c batch must give what its bits.c function gives,
+// on 4 lanes and, where the CPU has AVX2, on 8.
+// Prints the first bad input of every function that differs and
+// exits non-zero if any does.
+// usage: bits_check [threads]
+//   built as gcc -O2 bits_check.c bits.c bits_fast.c bits_batch.c -lpthread
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "bits.h"
+
+/* random words per check of the functions of more than one int */
+#define RANDOM (1 << 24)
+
+static int failures;
+
+static void fail(const char* f, const char* in, int got, int want) {
+  printf("%s(%s) = %d (0x%08x), want %d (0x%08x)\n", f, in, got,
+         (unsigned)got, want, (unsigned)want);
+  failures++;
+}
+
+/* the references, in ordinary C with no limits on operators */
+static int refAnyOddBit(int x) { return ((unsigned)x & 0xAAAAAAAAu) != 0; }
+static int refBang(int x) { return x == 0; }
+static int refIsAsciiDigit(int x) { return x >= '0' && x <= '9'; }
+static int refIsNonNegative(int x) { return x >= 0; }
+
+static int refBitCount(int x) {
+  unsigned u = x;
+  int n = 0;
+  for (; u; u &= u - 1)
+    n++;
+  return n;
+}
+
+/* 32 bits, so an odd count of 0s is an odd count of 1s */
+static int refBitParity(int x) { return refBitCount(x) & 1; }
+
+static int refHowManyBits(int x) {
+  unsigned u = x < 0 ? ~(unsigned)x : (unsigned)x;
+  int n = 1;
+  for (; u; u >>= 1)
+    n++;
+  return n;
+}
+
+static int refLeftBitCount(int x) {
+  unsigned u = x;
+  int n = 0;
+  for (; n < 32 && (u & 0x80000000u); u <<= 1)
+    n++;
+  return n;
+}
+
+static int refSatMul3(int x) {
+  long long p = 3LL * x;
+  return p > INT_MAX ? INT_MAX : p < INT_MIN ? INT_MIN : (int)p;
+}
+
+static int refIsEqual(int x, int y) { return x == y; }
+static int refIsNotEqual(int x, int y) { return x != y; }
+static int refIsGreater(int x, int y) { return x > y; }
+static int refIsLessOrEqual(int x, int y) { return x <= y; }
+
+static int refSubOK(int x, int y) {
+  long long d = (long long)x - y;
+  return d >= INT_MIN && d <= INT_MAX;
+}
+
+static int refBitMask(int highbit, int lowbit) {
+  unsigned hi = highbit == 31 ? ~0u : (1u << (highbit + 1)) - 1;
+  return lowbit > highbit ? 0 : (int)(hi & ~((1u << lowbit) - 1));
+}
+
+static int refGetByte(int x, int n) { return ((unsigned)x >> (8 * n)) & 255; }
+static int refLogicalShift(int x, int n) { return (int)((unsigned)x >> n); }
+/* C's % already keeps the sign of x */
+static int refRempwr2(int x, int n) { return x % (1 << n); }
+
+static int refReplaceByte(int x, int n, int c) {
+  return (int)(((unsigned)x & ~(0xFFu << (8 * n))) | ((unsigned)c << (8 * n)));
+}
+
+static int refRotateRight(int x, int n) {
+  unsigned u = x;
+  return (int)(n ? u >> n | u << (32 - n) : u);
+}
+
+static const struct {
+  const char* name;
+  int (*f)(int);
+  int (*ref)(int);
+} unary[] = {
+  {"anyOddBit", anyOddBit, refAnyOddBit},
+  {"bang", bang, refBang},
+  {"bitCount", bitCount, refBitCount},
+  {"bitParity", bitParity, refBitParity},
+  {"howManyBits", howManyBits, refHowManyBits},
+  {"isAsciiDigit", isAsciiDigit, refIsAsciiDigit},
+  {"isNonNegative", isNonNegative, refIsNonNegative},
+  {"leftBitCount", leftBitCount, refLeftBitCount},
+  {"satMul3", satMul3, refSatMul3},
+  {"fastBitCount", fastBitCount, refBitCount},
+  {"fastHowManyBits", fastHowManyBits, refHowManyBits},
+  {"fastLeftBitCount", fastLeftBitCount, refLeftBitCount},
+};
+
+#define NUNARY (sizeof(unary) / sizeof(unary[0]))
+
+/* one thread's share of the 2^32 inputs, and what it found */
+typedef struct {
+  uint64_t lo, hi;
+  long bad[NUNARY];
+  int first[NUNARY];
+} span;
+
+static void* check_span(void* arg) {
+  span* s = arg;
+  size_t f;
+  uint64_t i;
+  for (f = 0; f < NUNARY; f++)
+    for (i = s->lo; i < s->hi; i++) {
+      int x = (int)(uint32_t)i;
+      if (unary[f].f(x) != unary[f].ref(x) && !s->bad[f]++)
+        s->first[f] = x;
+    }
+  return NULL;
+}
+
+static void check_unary(int threads) {
+  pthread_t* th = malloc(sizeof(pthread_t) * threads);
+  span* s = calloc(threads, sizeof(span));
+  uint64_t all = 1ULL << 32;
+  char in[32];
+  size_t f;
+  int t;
+  for (t = 0; t < threads; t++) {
+    s[t].lo = all / threads * t;
+    s[t].hi = t == threads - 1 ? all : all / threads * (t + 1);
+    if (pthread_create(&th[t], NULL, check_span, &s[t])) {
+      fprintf(stderr, "cannot start a thread\n");
+      exit(2);
+    }
+  }
+  for (t = 0; t < threads; t++)
+    pthread_join(th[t], NULL);
+  for (f = 0; f < NUNARY; f++) {
+    long bad = 0;
+    int first = 0;
+    for (t = 0; t < threads; t++) {
+      if (s[t].bad[f] && !bad)
+        first = s[t].first[f];
+      bad += s[t].bad[f];
+    }
+    if (bad) {
+      snprintf(in, sizeof(in), "0x%08x", (unsigned)first);
+      fail(unary[f].name, in, unary[f].f(first), unary[f].ref(first));
+      printf("  %s: %ld of 2^32 inputs differ\n", unary[f].name, bad);
+    }
+  }
+  free(th);
+  free(s);
+}
+
+static uint32_t seed = 2463534242u;
+
+/* xorshift32, so every run sees the same inputs */
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/* the ends of the range and the words on either side of 0 */
+static const int edge[] = {
+  INT_MIN, INT_MIN + 1, INT_MIN + 2, -2, -1, 0, 1, 2,
+  INT_MAX - 2, INT_MAX - 1, INT_MAX, 0x30, 0x39, 0x40000000, -0x40000000,
+};
+
+#define NEDGE (sizeof(edge) / sizeof(edge[0]))
+
+/* y for x: equal a quarter of the time and close another quarter, */
+/* so the comparisons see equal and neighbouring pairs too */
+static int partner(int x, long i) {
+  switch (i & 3) {
+  case 0:
+    return x;
+  case 1:
+    return (int)((unsigned)x + (rnd() & 7) - 4);
+  default:
+    return (int)rnd();
+  }
+}
+
+static const struct {
+  const char* name;
+  int (*f)(int, int);
+  int (*ref)(int, int);
+} binary[] = {
+  {"isEqual", isEqual, refIsEqual},
+  {"isGreater", isGreater, refIsGreater},
+  {"isLessOrEqual", isLessOrEqual, refIsLessOrEqual},
+  {"isNotEqual", isNotEqual, refIsNotEqual},
+  {"subOK", subOK, refSubOK},
+};
+
+#define NBINARY (sizeof(binary) / sizeof(binary[0]))
+
+static void check_binary(void) {
+  char in[32];
+  size_t f, a, b;
+  long i;
+  for (f = 0; f < NBINARY; f++) {
+    int (*fn)(int, int) = binary[f].f, (*ref)(int, int) = binary[f].ref;
+    int bad = 0;
+    for (a = 0; a < NEDGE && !bad; a++)
+      for (b = 0; b < NEDGE && !bad; b++)
+        if (fn(edge[a], edge[b]) != ref(edge[a], edge[b])) {
+          snprintf(in, sizeof(in), "%d, %d", edge[a], edge[b]);
+          fail(binary[f].name, in, fn(edge[a], edge[b]),
+               ref(edge[a], edge[b]));
+          bad = 1;
+        }
+    for (i = 0; i < RANDOM && !bad; i++) {
+      int x = (int)rnd(), y = partner(x, i);
+      if (fn(x, y) != ref(x, y)) {
+        snprintf(in, sizeof(in), "%d, %d", x, y);
+        fail(binary[f].name, in, fn(x, y), ref(x, y));
+        bad = 1;
+      }
+    }
+  }
+}
+
+/* f(x, n) on random x for every n in [0, max] */
+static void check_count(const char* name, int (*fn)(int, int),
+                        int (*ref)(int, int), int max) {
+  char in[32];
+  long i;
+  int n;
+  for (n = 0; n <= max; n++)
+    for (i = 0; i < RANDOM / 32; i++) {
+      int x = i < (long)NEDGE ? edge[i] : (int)rnd();
+      if (fn(x, n) != ref(x, n)) {
+        snprintf(in, sizeof(in), "0x%08x, %d", (unsigned)x, n);
+        fail(name, in, fn(x, n), ref(x, n));
+        return;
+      }
+    }
+}
+
+static void check_counts(void) {
+  char in[32];
+  long i;
+  int h, l, n;
+  for (h = 0; h < 32; h++)
+    for (l = 0; l < 32; l++)
+      if (bitMask(h, l) != refBitMask(h, l)) {
+        snprintf(in, sizeof(in), "%d, %d", h, l);
+        fail("bitMask", in, bitMask(h, l), refBitMask(h, l));
+      }
+  check_count("getByte", getByte, refGetByte, 3);
+  check_count("logicalShift", logicalShift, refLogicalShift, 31);
+  check_count("rempwr2", rempwr2, refRempwr2, 30);
+  check_count("rotateRight", rotateRight, refRotateRight, 31);
+  /* every byte number with every replacement byte */
+  for (n = 0; n < 4; n++)
+    for (i = 0; i < RANDOM / 4; i++) {
+      int x = (int)rnd(), c = i & 255;
+      if (replaceByte(x, n, c) != refReplaceByte(x, n, c)) {
+        snprintf(in, sizeof(in), "0x%08x, %d, 0x%02x", (unsigned)x, n, c);
+        fail("replaceByte", in, replaceByte(x, n, c),
+             refReplaceByte(x, n, c));
+        break;
+      }
+    }
+}
+
+/* values per batch: not a multiple of 8, so the tails run too */
+#define BATCH ((1 << 20) + 7)
+
+static int32_t bx[BATCH], by[BATCH], bout[BATCH];
+
+/* out from name's batch against f on every x (and y), at lanes */
+static void batch_differs(const char* name, int lanes, const int32_t* out,
+                          int (*f1)(int), int (*f2)(int, int)) {
+  char in[48];
+  size_t i;
+  for (i = 0; i < BATCH; i++) {
+    int want = f1 ? f1(bx[i]) : f2(bx[i], by[i]);
+    if (out[i] != want) {
+      snprintf(in, sizeof(in), "[%zu] on %d lanes", i, lanes);
+      fail(name, in, out[i], want);
+      return;
+    }
+  }
+}
+
+static const struct {
+  const char* name;
+  void (*batch)(const int32_t*, int32_t*, size_t);
+  int (*f)(int);
+} unaryBatch[] = {
+  {"anyOddBitBatch", anyOddBitBatch, anyOddBit},
+  {"bangBatch", bangBatch, bang},
+  {"bitCountBatch", bitCountBatch, bitCount},
+  {"bitParityBatch", bitParityBatch, bitParity},
+  {"howManyBitsBatch", howManyBitsBatch, howManyBits},
+  {"isAsciiDigitBatch", isAsciiDigitBatch, isAsciiDigit},
+  {"isNonNegativeBatch", isNonNegativeBatch, isNonNegative},
+  {"leftBitCountBatch", leftBitCountBatch, leftBitCount},
+  {"satMul3Batch", satMul3Batch, satMul3},
+};
+
+static const struct {
+  const char* name;
+  void (*batch)(const int32_t*, const int32_t*, int32_t*, size_t);
+  int (*f)(int, int);
+} binaryBatch[] = {
+  {"isEqualBatch", isEqualBatch, isEqual},
+  {"isGreaterBatch", isGreaterBatch, isGreater},
+  {"isLessOrEqualBatch", isLessOrEqualBatch, isLessOrEqual},
+  {"isNotEqualBatch", isNotEqualBatch, isNotEqual},
+  {"subOKBatch", subOKBatch, subOK},
+};
+
+/* the fixed counts of the SCALAR batches, for batch_differs */
+static int count, count2;
+static int getByteN(int x) { return getByte(x, count); }
+static int logicalShiftN(int x) { return logicalShift(x, count); }
+static int rempwr2N(int x) { return rempwr2(x, count); }
+static int replaceByteN(int x) { return replaceByte(x, count, count2); }
+static int rotateRightN(int x) { return rotateRight(x, count); }
+
+/* every *Batch against its bits.c function, on 4 lanes and, where */
+/* the CPU has AVX2, on 8 */
+static void check_batches(void) {
+  size_t i, f;
+  int lanes;
+  for (i = 0; i < BATCH; i++) {
+    bx[i] = i < NEDGE ? edge[i] : (int)rnd();
+    by[i] = partner(bx[i], i);
+  }
+  for (lanes = 4; lanes <= 8; lanes += 4) {
+    if (batchLanes(lanes == 4 ? 4 : 0) != lanes)
+      continue;
+    for (f = 0; f < sizeof(unaryBatch) / sizeof(unaryBatch[0]); f++) {
+      unaryBatch[f].batch(bx, bout, BATCH);
+      batch_differs(unaryBatch[f].name, lanes, bout, unaryBatch[f].f, NULL);
+    }
+    for (f = 0; f < sizeof(binaryBatch) / sizeof(binaryBatch[0]); f++) {
+      binaryBatch[f].batch(bx, by, bout, BATCH);
+      batch_differs(binaryBatch[f].name, lanes, bout, NULL, binaryBatch[f].f);
+    }
+    /* bitMask's bit numbers must be below 32 */
+    for (i = 0; i < BATCH; i++) {
+      bx[i] &= 31;
+      by[i] &= 31;
+    }
+    bitMaskBatch(bx, by, bout, BATCH);
+    batch_differs("bitMaskBatch", lanes, bout, NULL, bitMask);
+    for (i = 0; i < BATCH; i++) {
+      bx[i] = i < NEDGE ? edge[i] : (int)rnd();
+      by[i] = partner(bx[i], i);
+    }
+    for (count = 0; count < 32; count++) {
+      if (count < 4) {
+        getByteBatch(bx, count, bout, BATCH);
+        batch_differs("getByteBatch", lanes, bout, getByteN, NULL);
+        for (count2 = 0; count2 < 256; count2 += 51) {
+          replaceByteBatch(bx, count, count2, bout, BATCH);
+          batch_differs("replaceByteBatch", lanes, bout, replaceByteN, NULL);
+        }
+      }
+      logicalShiftBatch(bx, count, bout, BATCH);
+      batch_differs("logicalShiftBatch", lanes, bout, logicalShiftN, NULL);
+      if (count <= 30) {
+        rempwr2Batch(bx, count, bout, BATCH);
+        batch_differs("rempwr2Batch", lanes, bout, rempwr2N, NULL);
+      }
+      rotateRightBatch(bx, count, bout, BATCH);
+      batch_differs("rotateRightBatch", lanes, bout, rotateRightN, NULL);
+    }
+    /* in place, from an address that is not 16-byte aligned */
+    for (i = 0; i < BATCH; i++)
+      bout[i] = bx[i];
+    satMul3Batch(bout + 1, bout + 1, BATCH - 1);
+    for (i = 1; i < BATCH; i++)
+      if (bout[i] != satMul3(bx[i])) {
+        fail("satMul3Batch", "in place", bout[i], satMul3(bx[i]));
+        break;
+      }
+  }
+  batchLanes(0);
+}
+
+int main(int argc, char* argv[]) {
+  long threads = argc > 1 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1 || threads > 1024) {
+    fprintf(stderr, "usage: %s [threads]\n", argv[0]);
+    return 2;
+  }
+  check_binary();
+  check_counts();
+  check_batches();
+  check_unary((int)threads);
+  if (!failures)
+    printf("all checks passed\n");
+  return failures != 0;
+}
@@ -0,0 +1,76 @@
+// bitCount, leftBitCount and howManyBits on the instructions the
+// puzzle rules kept them from using. The CPU is asked once, on the
+// first call from any thread, whether it has POPCNT and LZCNT; where
+// it lacks one they run the bits.c version.
+
+#include "bits.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_BITS
+#endif
+
+#ifdef HAVE_X86_BITS
+#include <pthread.h>
+
+/* 1 if the CPU runs the instruction, 0 if not, set by cpu_detect */
+static int popcnt, lzcnt;
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+
+static void cpu_detect(void) {
+  popcnt = __builtin_cpu_supports("popcnt");
+  lzcnt = __builtin_cpu_supports("abm");
+}
+
+__attribute__((target("popcnt")))
+static int popcntBitCount(int x) {
+  return _mm_popcnt_u32(x);
+}
+
+/* LZCNT gives 32 for 0, where BSR and __builtin_clz do not */
+__attribute__((target("lzcnt")))
+static int lzcntLeftBitCount(int x) {
+  return _lzcnt_u32(~x);
+}
+
+/* x ^ (x >> 31) drops the copies of the sign bit; one more for it */
+__attribute__((target("lzcnt")))
+static int lzcntHowManyBits(int x) {
+  return 33 - _lzcnt_u32(x ^ (x >> 31));
+}
+#endif
+
+/*
+ * fastBitCount - bitCount(x), on POPCNT where the CPU has it
+ */
+int fastBitCount(int x) {
+#ifdef HAVE_X86_BITS
+  pthread_once(&cpu_once, cpu_detect);
+  if (popcnt)
+    return popcntBitCount(x);
+#endif
+  return bitCount(x);
+}
+
+/*
+ * fastLeftBitCount - leftBitCount(x), on LZCNT where the CPU has it
+ */
+int fastLeftBitCount(int x) {
+#ifdef HAVE_X86_BITS
+  pthread_once(&cpu_once, cpu_detect);
+  if (lzcnt)
+    return lzcntLeftBitCount(x);
+#endif
+  return leftBitCount(x);
+}
+
+/*
+ * fastHowManyBits - howManyBits(x), on LZCNT where the CPU has it
+ */
+int fastHowManyBits(int x) {
+#ifdef HAVE_X86_BITS
+  pthread_once(&cpu_once, cpu_detect);
+  if (lzcnt)
+    return lzcntHowManyBits(x);
+#endif
+  return howManyBits(x);
+}
@@ -0,0 +1,164 @@
+#ifndef BITS_GENERIC_H
+#define BITS_GENERIC_H
+
+#include <stdint.h>
+
+/*
+ * bitCount, bitParity, howManyBits, leftBitCount, logicalShift,
+ * rotateRight and satMul3 of bits.c for 8, 16, 32 and 64-bit ints,
+ * each as name_uW for uintW_t and name_sW for intW_t, and through
+ * _Generic as bit_count, bit_parity, how_many_bits, left_bit_count,
+ * logical_shift, rotate_right and sat_mul3.
+ *
+ * The masks that bits.c builds by hand come from ~0 divided by a
+ * constant, which the compiler folds: ~0 / 3 is 0101..., ~0 / 5 is
+ * 00110011... and ~0 / 17 is 00001111....
+ * Every step is done in the unsigned type, so nothing depends on how
+ * signed shifts round or on overflow.
+ *
+ * _Generic picks by the exact-width types, so a long long on a target
+ * where int64_t is long needs a cast.
+ *
+ * Differences from bits.c, where the wider types need them:
+ *   how_many_bits of an unsigned value is its width without a sign
+ *     bit, so 0 needs 0 bits and 5 needs 3
+ *   sat_mul3 of an unsigned value saturates at the type's maximum
+ *   logical_shift and rotate_right take counts 0 to width - 1
+ */
+
+/* x >> n for a constant n, 0 once n reaches the width W */
+#define BG_SHR(W, x, n) ((n) < (W) ? (x) >> ((n) & ((W) - 1)) : 0)
+
+#define BITS_GENERIC(W)                                                 \
+  static inline int bitCount_u##W(uint##W##_t x) {                      \
+    const uint##W##_t m1 = (uint##W##_t)~(uint##W##_t)0 / 3;            \
+    const uint##W##_t m2 = (uint##W##_t)~(uint##W##_t)0 / 5;            \
+    const uint##W##_t m4 = (uint##W##_t)~(uint##W##_t)0 / 17;           \
+    x = (uint##W##_t)((x & m1) + ((x >> 1) & m1));                      \
+    x = (uint##W##_t)((x & m2) + ((x >> 2) & m2));                      \
+    x = (uint##W##_t)((x + (x >> 4)) & m4);                             \
+    x = (uint##W##_t)(x + BG_SHR(W, x, 8));                             \
+    x = (uint##W##_t)(x + BG_SHR(W, x, 16));                            \
+    x = (uint##W##_t)(x + BG_SHR(W, x, 32));                            \
+    return x & 127;                                                     \
+  }                                                                     \
+                                                                        \
+  static inline int bitParity_u##W(uint##W##_t x) {                     \
+    x = (uint##W##_t)(x ^ BG_SHR(W, x, 32));                            \
+    x = (uint##W##_t)(x ^ BG_SHR(W, x, 16));                            \
+    x = (uint##W##_t)(x ^ BG_SHR(W, x, 8));                             \
+    x = (uint##W##_t)(x ^ (x >> 4));                                    \
+    x = (uint##W##_t)(x ^ (x >> 2));                                    \
+    x = (uint##W##_t)(x ^ (x >> 1));                                    \
+    return x & 1;                                                       \
+  }                                                                     \
+                                                                        \
+  /* the position of the highest set bit plus one, 0 for 0: the */      \
+  /* binary search of howManyBits, halving from the widest step */      \
+  static inline int bitLength_u##W(uint##W##_t x) {                     \
+    int n = 0, k;                                                       \
+    k = (W > 32 && BG_SHR(W, x, 32) != 0) << 5;                         \
+    x = (uint##W##_t)(x >> k);                                          \
+    n += k;                                                             \
+    k = (W > 16 && BG_SHR(W, x, 16) != 0) << 4;                         \
+    x = (uint##W##_t)(x >> k);                                          \
+    n += k;                                                             \
+    k = (W > 8 && BG_SHR(W, x, 8) != 0) << 3;                           \
+    x = (uint##W##_t)(x >> k);                                          \
+    n += k;                                                             \
+    k = ((x >> 4) != 0) << 2;                                           \
+    x = (uint##W##_t)(x >> k);                                          \
+    n += k;                                                             \
+    k = ((x >> 2) != 0) << 1;                                           \
+    x = (uint##W##_t)(x >> k);                                          \
+    n += k;                                                             \
+    k = (x >> 1) != 0;                                                  \
+    x = (uint##W##_t)(x >> k);                                          \
+    return n + k + (x & 1);                                             \
+  }                                                                     \
+                                                                        \
+  static inline int howManyBits_u##W(uint##W##_t x) {                   \
+    return bitLength_u##W(x);                                           \
+  }                                                                     \
+                                                                        \
+  static inline int leftBitCount_u##W(uint##W##_t x) {                  \
+    return W - bitLength_u##W((uint##W##_t)~x);                         \
+  }                                                                     \
+                                                                        \
+  static inline uint##W##_t logicalShift_u##W(uint##W##_t x, int n) {   \
+    return (uint##W##_t)(x >> n);                                       \
+  }                                                                     \
+                                                                        \
+  static inline uint##W##_t rotateRight_u##W(uint##W##_t x, int n) {    \
+    return (uint##W##_t)((x >> n) | (x << ((W - n) & (W - 1))));        \
+  }                                                                     \
+                                                                        \
+  static inline uint##W##_t satMul3_u##W(uint##W##_t x) {               \
+    const uint##W##_t max = (uint##W##_t)~(uint##W##_t)0;               \
+    uint##W##_t over = (uint##W##_t)(x > max / 3);                      \
+    over = (uint##W##_t)((uint##W##_t)0 - over);                        \
+    return (uint##W##_t)(((uint##W##_t)(x * 3u) & ~over) | over);       \
+  }                                                                     \
+                                                                        \
+  static inline int bitCount_s##W(int##W##_t x) {                       \
+    return bitCount_u##W((uint##W##_t)x);                               \
+  }                                                                     \
+                                                                        \
+  static inline int bitParity_s##W(int##W##_t x) {                      \
+    return bitParity_u##W((uint##W##_t)x);                              \
+  }                                                                     \
+                                                                        \
+  /* copies of the sign bit cleared by x ^ sign, plus the sign bit */   \
+  static inline int howManyBits_s##W(int##W##_t x) {                    \
+    uint##W##_t u = (uint##W##_t)x;                                     \
+    uint##W##_t sign = (uint##W##_t)((uint##W##_t)0 - (u >> (W - 1)));  \
+    return bitLength_u##W((uint##W##_t)(u ^ sign)) + 1;                 \
+  }                                                                     \
+                                                                        \
+  static inline int leftBitCount_s##W(int##W##_t x) {                   \
+    return leftBitCount_u##W((uint##W##_t)x);                           \
+  }                                                                     \
+                                                                        \
+  static inline int##W##_t logicalShift_s##W(int##W##_t x, int n) {     \
+    return (int##W##_t)logicalShift_u##W((uint##W##_t)x, n);            \
+  }                                                                     \
+                                                                        \
+  static inline int##W##_t rotateRight_s##W(int##W##_t x, int n) {      \
+    return (int##W##_t)rotateRight_u##W((uint##W##_t)x, n);             \
+  }                                                                     \
+                                                                        \
+  /* as in bits.c: 3x overflowed if 2x or 3x has the wrong sign */      \
+  static inline int##W##_t satMul3_s##W(int##W##_t x) {                 \
+    const uint##W##_t min = (uint##W##_t)1 << (W - 1);                  \
+    uint##W##_t u = (uint##W##_t)x;                                     \
+    uint##W##_t two = (uint##W##_t)(u << 1);                            \
+    uint##W##_t three = (uint##W##_t)(two + u);                         \
+    uint##W##_t over = (uint##W##_t)(((u ^ two) | (u ^ three)) & min);  \
+    uint##W##_t mask = (uint##W##_t)((uint##W##_t)0 - (over >> (W - 1))); \
+    uint##W##_t sat = (uint##W##_t)(min - 1 + (u >> (W - 1)));          \
+    return (int##W##_t)((three & ~mask) | (sat & mask));                \
+  }
+
+BITS_GENERIC(8)
+BITS_GENERIC(16)
+BITS_GENERIC(32)
+BITS_GENERIC(64)
+
+#undef BITS_GENERIC
+
+#define BG_SELECT(name, x)                                              \
+  _Generic((x),                                                         \
+           uint8_t: name##_u8, uint16_t: name##_u16,                    \
+           uint32_t: name##_u32, uint64_t: name##_u64,                  \
+           int8_t: name##_s8, int16_t: name##_s16,                      \
+           int32_t: name##_s32, int64_t: name##_s64)
+
+#define bit_count(x) BG_SELECT(bitCount, x)(x)
+#define bit_parity(x) BG_SELECT(bitParity, x)(x)
+#define how_many_bits(x) BG_SELECT(howManyBits, x)(x)
+#define left_bit_count(x) BG_SELECT(leftBitCount, x)(x)
+#define logical_shift(x, n) BG_SELECT(logicalShift, x)((x), (n))
+#define rotate_right(x, n) BG_SELECT(rotateRight, x)((x), (n))
+#define sat_mul3(x) BG_SELECT(satMul3, x)(x)
+
+#endif
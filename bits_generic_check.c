@@ -0,0 +1,252 @@
+// Checks bits_generic.h against plain C versions of what each function
+// should compute at each width, done in uint64_t. The 8 and 16-bit
+// functions are run on every input, those of 32 and 64 bits on edge
+// values and random words of every length, and the shifts and
+// rotations on every count below the width. The 32-bit signed ones
+// must also give what bits.c gives, and the _Generic names must pick
+// the function of their argument's width.
+// Prints the first bad input of every function that differs and
+// exits non-zero if any does.
+// usage: bits_generic_check
+//   built as gcc -O2 bits_generic_check.c bits.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "bits.h"
+#include "bits_generic.h"
+
+/* random words per width of 32 and 64 bits */
+#define RANDOM (1 << 22)
+
+static int failures;
+
+/* prints the first difference of each function, counts them all */
+static void fail(const char* f, uint64_t in, int n, uint64_t got,
+                 uint64_t want) {
+  static const char* seen[128];
+  static int nseen;
+  int i;
+  failures++;
+  for (i = 0; i < nseen; i++)
+    if (!strcmp(seen[i], f))
+      return;
+  if (nseen < 128)
+    seen[nseen++] = f;
+  if (n < 0)
+    printf("%s(0x%" PRIx64 ") = 0x%" PRIx64 ", want 0x%" PRIx64 "\n", f, in,
+           got, want);
+  else
+    printf("%s(0x%" PRIx64 ", %d) = 0x%" PRIx64 ", want 0x%" PRIx64 "\n", f,
+           in, n, got, want);
+}
+
+/* the references, on the low W bits of a uint64_t */
+static uint64_t mask(int W) {
+  return W == 64 ? ~(uint64_t)0 : ((uint64_t)1 << W) - 1;
+}
+
+static int64_t sext(uint64_t u, int W) {
+  return W == 64 ? (int64_t)u
+       : (int64_t)(u << (64 - W)) >> (64 - W);
+}
+
+static int refCount(uint64_t u) {
+  int n = 0;
+  for (; u; u &= u - 1)
+    n++;
+  return n;
+}
+
+static int refLength(uint64_t u) {
+  int n = 0;
+  for (; u; u >>= 1)
+    n++;
+  return n;
+}
+
+static int refLeft(uint64_t u, int W) {
+  int n = 0;
+  while (n < W && (u >> (W - 1 - n) & 1))
+    n++;
+  return n;
+}
+
+/* bits.c's howManyBits: the bits of x, or of ~x if negative, plus a */
+/* sign bit */
+static int refHowManyS(uint64_t u, int W) {
+  int64_t s = sext(u, W);
+  return refLength((uint64_t)(s < 0 ? ~s : s)) + 1;
+}
+
+static uint64_t refRotate(uint64_t u, int n, int W) {
+  return n ? (u >> n | u << (W - n)) & mask(W) : u;
+}
+
+static uint64_t refSatU(uint64_t u, int W) {
+  return u > mask(W) / 3 ? mask(W) : u * 3;
+}
+
+static uint64_t refSatS(uint64_t u, int W) {
+  __int128 t = (__int128)sext(u, W) * 3;
+  __int128 max = (__int128)(mask(W) >> 1), min = -max - 1;
+  return (uint64_t)(t > max ? max : t < min ? min : t) & mask(W);
+}
+
+#define SAME(name, in, n, got, want)                                    \
+  do {                                                                  \
+    uint64_t g_ = (uint64_t)(got), w_ = (uint64_t)(want);               \
+    if (g_ != w_)                                                       \
+      fail(name, in, n, g_, w_);                                        \
+  } while (0)
+
+/* every function of width W on the low W bits of u, the shifts and */
+/* rotations on every count; signed results compared as W bits */
+#define CHECK_WIDTH(W)                                                  \
+  static void check_##W(uint64_t u) {                                   \
+    uint##W##_t x = (uint##W##_t)u;                                     \
+    int##W##_t s = (int##W##_t)x;                                       \
+    int n;                                                              \
+    u &= mask(W);                                                       \
+    SAME("bitCount_u" #W, u, -1, bitCount_u##W(x), refCount(u));        \
+    SAME("bitCount_s" #W, u, -1, bitCount_s##W(s), refCount(u));        \
+    SAME("bitParity_u" #W, u, -1, bitParity_u##W(x), refCount(u) & 1);  \
+    SAME("bitParity_s" #W, u, -1, bitParity_s##W(s), refCount(u) & 1);  \
+    SAME("howManyBits_u" #W, u, -1, howManyBits_u##W(x), refLength(u)); \
+    SAME("howManyBits_s" #W, u, -1, howManyBits_s##W(s),                \
+         refHowManyS(u, W));                                            \
+    SAME("leftBitCount_u" #W, u, -1, leftBitCount_u##W(x),              \
+         refLeft(u, W));                                                \
+    SAME("leftBitCount_s" #W, u, -1, leftBitCount_s##W(s),              \
+         refLeft(u, W));                                                \
+    SAME("satMul3_u" #W, u, -1, satMul3_u##W(x), refSatU(u, W));        \
+    SAME("satMul3_s" #W, u, -1, (uint##W##_t)satMul3_s##W(s),           \
+         refSatS(u, W));                                                \
+    for (n = 0; n < W; n++) {                                           \
+      SAME("logicalShift_u" #W, u, n, logicalShift_u##W(x, n), u >> n); \
+      SAME("logicalShift_s" #W, u, n,                                   \
+           (uint##W##_t)logicalShift_s##W(s, n), u >> n);               \
+      SAME("rotateRight_u" #W, u, n, rotateRight_u##W(x, n),            \
+           refRotate(u, n, W));                                         \
+      SAME("rotateRight_s" #W, u, n,                                    \
+           (uint##W##_t)rotateRight_s##W(s, n), refRotate(u, n, W));    \
+    }                                                                   \
+  }
+
+CHECK_WIDTH(8)
+CHECK_WIDTH(16)
+CHECK_WIDTH(32)
+CHECK_WIDTH(64)
+
+static uint32_t seed = 2463534242u;
+
+/* xorshift32, so every run sees the same inputs */
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/* a random word cut to a random length, so short ones come up too */
+static uint64_t rnd_word(void) {
+  uint64_t u = (uint64_t)rnd() << 32 | rnd();
+  return u >> (rnd() & 63);
+}
+
+/* the ends of each signed and unsigned range, and either side of 0 */
+static const uint64_t edge[] = {
+  0, 1, 2, 3, 0x7F, 0x80, 0x81, 0xFF, 0x5555, 0x7FFF, 0x8000, 0xFFFF,
+  0x55555555, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFE, 0xFFFFFFFF,
+  0x5555555555555555, 0x7FFFFFFFFFFFFFFF, 0x8000000000000000,
+  0x8000000000000001, 0xFFFFFFFFFFFFFFFE, 0xFFFFFFFFFFFFFFFF,
+};
+
+#define NEDGE (sizeof(edge) / sizeof(edge[0]))
+
+/* the _s32 functions against bits.c, which works on the same ints */
+static void check_bits(uint64_t u) {
+  int x = (int)(uint32_t)u, n;
+  SAME("bitCount_s32 vs bits.c", u, -1, bitCount_s32(x), bitCount(x));
+  SAME("bitParity_s32 vs bits.c", u, -1, bitParity_s32(x), bitParity(x));
+  SAME("howManyBits_s32 vs bits.c", u, -1, howManyBits_s32(x),
+       howManyBits(x));
+  SAME("leftBitCount_s32 vs bits.c", u, -1, leftBitCount_s32(x),
+       leftBitCount(x));
+  SAME("satMul3_s32 vs bits.c", u, -1, (uint32_t)satMul3_s32(x),
+       (uint32_t)satMul3(x));
+  for (n = 0; n < 32; n++) {
+    SAME("logicalShift_s32 vs bits.c", u, n, (uint32_t)logicalShift_s32(x, n),
+         (uint32_t)logicalShift(x, n));
+    SAME("rotateRight_s32 vs bits.c", u, n, (uint32_t)rotateRight_s32(x, n),
+         (uint32_t)rotateRight(x, n));
+  }
+}
+
+/* each _Generic name on a value whose answer depends on its width */
+static void check_generic(void) {
+  SAME("how_many_bits(uint8_t)", 0x80, -1, how_many_bits((uint8_t)0x80), 8);
+  SAME("how_many_bits(int8_t)", 0xFF, -1, how_many_bits((int8_t)-1), 1);
+  SAME("how_many_bits(int16_t)", 0x8000, -1,
+       how_many_bits((int16_t)INT16_MIN), 16);
+  SAME("how_many_bits(int64_t)", 0x8000000000000000, -1,
+       how_many_bits((int64_t)INT64_MIN), 64);
+  SAME("left_bit_count(uint8_t)", 0xF0, -1, left_bit_count((uint8_t)0xF0),
+       4);
+  SAME("left_bit_count(int16_t)", 0xFFFF, -1, left_bit_count((int16_t)-1),
+       16);
+  SAME("left_bit_count(uint32_t)", 0xFFFFFFFF, -1,
+       left_bit_count((uint32_t)0xFFFFFFFF), 32);
+  SAME("left_bit_count(int64_t)", 0xFFFFFFFFFFFFFFFF, -1,
+       left_bit_count((int64_t)-1), 64);
+  SAME("bit_count(int8_t)", 0xFF, -1, bit_count((int8_t)-1), 8);
+  SAME("bit_count(uint64_t)", 0xFFFFFFFFFFFFFFFF, -1,
+       bit_count((uint64_t)-1), 64);
+  SAME("bit_parity(int32_t)", 0xFFFFFFFF, -1, bit_parity((int32_t)-1), 0);
+  SAME("bit_parity(uint16_t)", 0x7FFF, -1, bit_parity((uint16_t)0x7FFF), 1);
+  SAME("logical_shift(int8_t)", 0x80, 7,
+       (uint8_t)logical_shift((int8_t)-128, 7), 1);
+  SAME("logical_shift(int64_t)", 0xFFFFFFFFFFFFFFFF, 63,
+       logical_shift((int64_t)-1, 63), 1);
+  SAME("rotate_right(uint16_t)", 1, 1, rotate_right((uint16_t)1, 1), 0x8000);
+  SAME("rotate_right(uint8_t)", 1, 1, rotate_right((uint8_t)1, 1), 0x80);
+  SAME("sat_mul3(uint8_t)", 100, -1, sat_mul3((uint8_t)100), 255);
+  SAME("sat_mul3(int16_t)", 20000, -1, sat_mul3((int16_t)20000), INT16_MAX);
+  SAME("sat_mul3(int64_t)", 0x8000000000000000, -1,
+       (uint64_t)sat_mul3((int64_t)INT64_MIN), 0x8000000000000000);
+}
+
+/* each result has the type of the argument */
+_Static_assert(sizeof(logical_shift((int8_t)0, 0)) == 1, "int8_t");
+_Static_assert(sizeof(rotate_right((uint16_t)0, 0)) == 2, "uint16_t");
+_Static_assert(sizeof(sat_mul3((int32_t)0)) == 4, "int32_t");
+_Static_assert(sizeof(sat_mul3((uint64_t)0)) == 8, "uint64_t");
+
+int main(void) {
+  uint64_t u;
+  size_t e;
+  long i;
+  for (u = 0; u < 256; u++)
+    check_8(u);
+  for (u = 0; u < 65536; u++)
+    check_16(u);
+  for (e = 0; e < NEDGE; e++) {
+    check_32(edge[e]);
+    check_64(edge[e]);
+    check_bits(edge[e]);
+  }
+  for (i = 0; i < RANDOM; i++) {
+    u = rnd_word();
+    check_32(u);
+    check_64(u);
+    check_bits(u);
+  }
+  check_generic();
+  if (failures) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
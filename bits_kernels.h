@@ -0,0 +1,168 @@
+// The bodies of the bits.c puzzles, written once over a lane type
+// so the same operations run on one int or on a whole SIMD vector.
+// Before each inclusion define
+//   KT       the lane type: int, or a GCC vector of int
+//   K(name)  the name to give each function for this lane type
+//   KATTR    attributes for the functions (e.g. a target ISA)
+// ! is spelled KNOT, since C has no ! on vectors: a comparison gives
+// 1 on an int and -1 on a vector lane, and & 1 makes both 1.
+
+#define KNOT(x) (((x) == 0) & 1)
+
+KATTR static inline KT K(anyOddBit)(KT x) {
+  int filter = (170 << 24) + (170 << 16) + (170 << 8) + 170;
+  return KNOT(KNOT(x & filter));
+}
+
+KATTR static inline KT K(bang)(KT x) {
+  KT rv = x | x >> 16;
+  rv |= (rv >> 8);
+  rv |= (rv >> 4);
+  rv |= (rv >> 2);
+  rv |= (rv >> 1);
+  return (~rv) & 1;
+}
+
+KATTR static inline KT K(bitCount)(KT x) {
+  int mask1 = (((((85 << 8) + 85) << 8) + 85) << 8) + 85;
+  int mask2 = (((((51 << 8) + 51) << 8) + 51) << 8) + 51;
+  int mask3 = (((((15 << 8) + 15) << 8) + 15) << 8) + 15;
+  int mask4 = (255 << 16) + 255;
+  int mask5 = (255 << 8) + 255;
+  KT a = (x & mask1) + ((x >> 1) & mask1);
+  KT b = (a & mask2) + ((a >> 2) & mask2);
+  KT c = (b & mask3) + ((b >> 4) & mask3);
+  KT d = (c & mask4) + ((c >> 8) & mask4);
+  return (d + (d >> 16)) & mask5;
+}
+
+KATTR static inline KT K(bitMask)(KT highbit, KT lowbit) {
+  KT a = ~0u << lowbit;
+  KT b = ~0u << highbit;
+  b = b << 1;
+  return a & ~b;
+}
+
+KATTR static inline KT K(bitParity)(KT x) {
+  KT y = x ^ (x >> 16);
+  y = y ^ (y >> 8);
+  y = y ^ (y >> 4);
+  y = y ^ (y >> 2);
+  y = y ^ (y >> 1);
+  return y & 1;
+}
+
+KATTR static inline KT K(getByte)(KT x, int n) {
+  return (x >> (n << 3)) & 255;
+}
+
+KATTR static inline KT K(howManyBits)(KT x) {
+  KT rv, a, b, c, d, e;
+  KT z = ~(x >> 31);
+  KT y = (z & x) | (~z & ~x);
+  a = ((y >> 16) & ((255 << 8) + 255));
+  y = y >> (KNOT(KNOT(a)) << 4);
+  b = ((y >> 8) & 255);
+  y = y >> (KNOT(KNOT(b)) << 3);
+  c = ((y >> 4) & 15);
+  y = y >> (KNOT(KNOT(c)) << 2);
+  d = ((y >> 2)) & 3;
+  y = y >> (KNOT(KNOT(d)) << 1);
+  e = ((y >> 1)) & 1;
+  y = y >> (KNOT(KNOT(e)));
+  rv = (KNOT(a) << 4) + (KNOT(b) << 3) + (KNOT(c) << 2) + (KNOT(d) << 1)
+    + KNOT(e) + KNOT(y & 1);
+  return 34 + ~rv;
+}
+
+KATTR static inline KT K(isAsciiDigit)(KT x) {
+  return KNOT((x + ~0x2F) >> 31) & KNOT(KNOT((x + ~0x39) >> 31));
+}
+
+KATTR static inline KT K(isEqual)(KT x, KT y) {
+  return KNOT(x ^ y);
+}
+
+KATTR static inline KT K(isGreater)(KT x, KT y) {
+  KT equal = KNOT(x ^ y);
+  KT xs = (x >> 31) & 1;
+  KT ys = (y >> 31) & 1;
+  KT pos_neg = KNOT(xs) & ys;
+  KT neg_pos = xs & KNOT(ys);
+  return pos_neg | (KNOT((x + ~y) >> 31) & KNOT(equal) & KNOT(neg_pos));
+}
+
+KATTR static inline KT K(isLessOrEqual)(KT x, KT y) {
+  return KNOT(K(isGreater)(x, y));
+}
+
+KATTR static inline KT K(isNonNegative)(KT x) {
+  return KNOT(x >> 31);
+}
+
+KATTR static inline KT K(isNotEqual)(KT x, KT y) {
+  return KNOT(KNOT(x ^ y));
+}
+
+KATTR static inline KT K(leftBitCount)(KT x) {
+  KT a, b, c, d, e;
+  KT y = ~x;
+  a = ((y >> 16) & ((255 << 8) + 255));
+  y = y >> (KNOT(KNOT(a)) << 4);
+  b = ((y >> 8) & 255);
+  y = y >> (KNOT(KNOT(b)) << 3);
+  c = ((y >> 4) & 15);
+  y = y >> (KNOT(KNOT(c)) << 2);
+  d = ((y >> 2)) & 3;
+  y = y >> (KNOT(KNOT(d)) << 1);
+  e = ((y >> 1)) & 1;
+  y = y >> (KNOT(KNOT(e)));
+  return (KNOT(a) << 4) + (KNOT(b) << 3) + (KNOT(c) << 2) + (KNOT(d) << 1)
+    + KNOT(e) + KNOT(y & 1);
+}
+
+KATTR static inline KT K(logicalShift)(KT x, int n) {
+  KT y = x >> n;
+  int a = (32 + ~n);
+  int filter = ~(((~0u) << a) << 1);
+  return y & filter;
+}
+
+KATTR static inline KT K(rempwr2)(KT x, int n) {
+  KT s = x >> 31;
+  KT rem = (~(~0u << n)) & x;
+  KT mask = (KNOT(KNOT(rem)) << 31) >> 31;
+  return rem + ((~(1 << n) + 1) & s & mask);
+}
+
+KATTR static inline KT K(replaceByte)(KT x, int n, int c) {
+  KT rv = x & ~(0xFF << (n << 3));
+  rv |= (c << (n << 3));
+  return rv;
+}
+
+KATTR static inline KT K(rotateRight)(KT x, int n) {
+  int a = (33 + ~n) & 31;
+  return ((x >> n) & (~((~0u) << a))) | (x << a);
+}
+
+KATTR static inline KT K(satMul3)(KT x) {
+  KT sign = (x >> 31) & 1;
+  KT two = x << 1;
+  KT three = two + x;
+  KT twosign = (two >> 31) & 1;
+  KT threesign = (three >> 31) & 1;
+  KT neg = (((sign ^ twosign) | (sign ^ threesign)) << 31) >> 31;
+  int min = (1 << 31);
+  KT filter = (sign << 31) >> 31;
+  return (three & ~neg) | (neg & ((~filter & (~min)) | (filter & min)));
+}
+
+KATTR static inline KT K(subOK)(KT x, KT y) {
+  KT xs = x >> 31 & 1;
+  KT ys = y >> 31 & 1;
+  KT diffs = (x + ~y + 1) >> 31 & 1;
+  return KNOT(((xs & KNOT(ys) & KNOT(diffs)) | (KNOT(xs) & ys & diffs)));
+}
+
+#undef KNOT
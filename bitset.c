@@ -0,0 +1,185 @@
+// Dense bitsets over 64-bit words: the one-word bitMask and
+// bitCount of bits.c carried to a whole array of words.
+
+#include <stdlib.h>
+#include <string.h>
+#include "bitset.h"
+
+/* bitMask for 64-bit words: bits lo through hi, lo <= hi < 64 */
+static uint64_t word_mask(unsigned hi, unsigned lo) {
+  uint64_t a = ~(uint64_t)0 << lo;
+  uint64_t b = (~(uint64_t)0 << hi) << 1;
+  return a & ~b;
+}
+
+static unsigned word_count(uint64_t w) {
+  return __builtin_popcountll(w);
+}
+
+/* clears the bits past nbits in the last word */
+static void trim(bitset* b) {
+  if (b->nbits & 63)
+    b->w[b->nwords - 1] &= word_mask((b->nbits & 63) - 1, 0);
+}
+
+int bitset_init(bitset* b, size_t nbits) {
+  b->nbits = nbits;
+  b->nwords = (nbits + 63) / 64;
+  b->w = calloc(b->nwords ? b->nwords : 1, sizeof(uint64_t));
+  b->ranks = NULL;
+  b->nblocks = 0;
+  return b->w ? 0 : -1;
+}
+
+void bitset_free(bitset* b) {
+  free(b->w);
+  free(b->ranks);
+  b->w = b->ranks = NULL;
+  b->nbits = b->nwords = b->nblocks = 0;
+}
+
+/* sets or clears [lo, hi): whole words by memset, the ends by mask */
+static void range(bitset* b, size_t lo, size_t hi, int set) {
+  size_t first, last;
+  uint64_t m;
+  if (lo >= hi)
+    return;
+  first = lo >> 6;
+  last = (hi - 1) >> 6;
+  if (first == last) {
+    m = word_mask((hi - 1) & 63, lo & 63);
+    b->w[first] = set ? b->w[first] | m : b->w[first] & ~m;
+    return;
+  }
+  m = word_mask(63, lo & 63);
+  b->w[first] = set ? b->w[first] | m : b->w[first] & ~m;
+  memset(b->w + first + 1, set ? 0xFF : 0, (last - first - 1) * 8);
+  m = word_mask((hi - 1) & 63, 0);
+  b->w[last] = set ? b->w[last] | m : b->w[last] & ~m;
+}
+
+void bitset_set_range(bitset* b, size_t lo, size_t hi) {
+  range(b, lo, hi, 1);
+}
+
+void bitset_clear_range(bitset* b, size_t lo, size_t hi) {
+  range(b, lo, hi, 0);
+}
+
+size_t bitset_count_range(const bitset* b, size_t lo, size_t hi) {
+  size_t first, last, i, n;
+  if (lo >= hi)
+    return 0;
+  first = lo >> 6;
+  last = (hi - 1) >> 6;
+  if (first == last)
+    return word_count(b->w[first] & word_mask((hi - 1) & 63, lo & 63));
+  n = word_count(b->w[first] & word_mask(63, lo & 63));
+  for (i = first + 1; i < last; i++)
+    n += word_count(b->w[i]);
+  return n + word_count(b->w[last] & word_mask((hi - 1) & 63, 0));
+}
+
+size_t bitset_count(const bitset* b) {
+  return bitset_count_range(b, 0, b->nbits);
+}
+
+size_t bitset_next(const bitset* b, size_t i) {
+  size_t k;
+  uint64_t w;
+  if (i >= b->nbits)
+    return BITSET_NONE;
+  k = i >> 6;
+  w = b->w[k] & (~(uint64_t)0 << (i & 63));
+  while (!w) {
+    if (++k == b->nwords)
+      return BITSET_NONE;
+    w = b->w[k];
+  }
+  return k * 64 + __builtin_ctzll(w);
+}
+
+int bitset_index(bitset* b) {
+  size_t nblocks = (b->nwords + BITSET_BLOCK - 1) / BITSET_BLOCK, i;
+  uint64_t n = 0;
+  uint64_t* r = realloc(b->ranks, (nblocks + 1) * sizeof(uint64_t));
+  if (!r)
+    return -1;
+  b->ranks = r;
+  b->nblocks = nblocks;
+  for (i = 0; i < b->nwords; i++) {
+    if (i % BITSET_BLOCK == 0)
+      b->ranks[i / BITSET_BLOCK] = n;
+    n += word_count(b->w[i]);
+  }
+  /* past the last block: the whole count, which ends select's search */
+  b->ranks[nblocks] = n;
+  return 0;
+}
+
+size_t bitset_rank(const bitset* b, size_t i) {
+  size_t k, word;
+  size_t n;
+  if (i >= b->nbits)
+    return b->ranks[b->nblocks];
+  word = i >> 6;
+  n = b->ranks[word / BITSET_BLOCK];
+  for (k = word - word % BITSET_BLOCK; k < word; k++)
+    n += word_count(b->w[k]);
+  if (i & 63)
+    n += word_count(b->w[word] & word_mask((i & 63) - 1, 0));
+  return n;
+}
+
+size_t bitset_select(const bitset* b, size_t k) {
+  size_t lo = 0, hi = b->nblocks, i;
+  uint64_t w;
+  if (k >= b->ranks[b->nblocks])
+    return BITSET_NONE;
+  /* the last block whose count before it is at most k */
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (b->ranks[mid] <= k)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  k -= b->ranks[lo];
+  for (i = lo * BITSET_BLOCK; word_count(b->w[i]) <= k; i++)
+    k -= word_count(b->w[i]);
+  w = b->w[i];
+  while (k--)
+    w &= w - 1;
+  return i * 64 + __builtin_ctzll(w);
+}
+
+static size_t common(const bitset* dst, const bitset* src) {
+  return dst->nwords < src->nwords ? dst->nwords : src->nwords;
+}
+
+void bitset_and(bitset* dst, const bitset* src) {
+  size_t i, n = common(dst, src);
+  for (i = 0; i < n; i++)
+    dst->w[i] &= src->w[i];
+  memset(dst->w + n, 0, (dst->nwords - n) * 8);
+}
+
+void bitset_or(bitset* dst, const bitset* src) {
+  size_t i, n = common(dst, src);
+  for (i = 0; i < n; i++)
+    dst->w[i] |= src->w[i];
+  trim(dst);
+}
+
+void bitset_xor(bitset* dst, const bitset* src) {
+  size_t i, n = common(dst, src);
+  for (i = 0; i < n; i++)
+    dst->w[i] ^= src->w[i];
+  trim(dst);
+}
+
+void bitset_andnot(bitset* dst, const bitset* src) {
+  size_t i, n = common(dst, src);
+  for (i = 0; i < n; i++)
+    dst->w[i] &= ~src->w[i];
+}
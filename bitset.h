@@ -0,0 +1,70 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A fixed-size set of the integers below nbits, one bit each in
+ * 64-bit words, bit i of word i / 64 for integer i. Bits at and past
+ * nbits in the last word are always 0.
+ *
+ * rank and select need the per-block counts that bitset_index builds.
+ * Any change to the bits leaves them out of date until it runs again.
+ */
+typedef struct bitset bitset;
+
+struct bitset {
+  uint64_t* w;
+  size_t nbits, nwords;
+  /* ranks[b]: set bits in the words before block b (BITSET_BLOCK words) */
+  uint64_t* ranks;
+  size_t nblocks;
+};
+
+/* words per rank block: one count per 512 bits */
+#define BITSET_BLOCK 8
+
+/* no integer: what select and the find functions return for none */
+#define BITSET_NONE ((size_t)-1)
+
+/* 0 on success, -1 with errno set if memory runs out */
+int bitset_init(bitset* b, size_t nbits);
+void bitset_free(bitset* b);
+
+static inline void bitset_set(bitset* b, size_t i) {
+  b->w[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static inline void bitset_clear(bitset* b, size_t i) {
+  b->w[i >> 6] &= ~((uint64_t)1 << (i & 63));
+}
+
+static inline int bitset_test(const bitset* b, size_t i) {
+  return (b->w[i >> 6] >> (i & 63)) & 1;
+}
+
+/* every bit in [lo, hi) */
+void bitset_set_range(bitset* b, size_t lo, size_t hi);
+void bitset_clear_range(bitset* b, size_t lo, size_t hi);
+size_t bitset_count_range(const bitset* b, size_t lo, size_t hi);
+size_t bitset_count(const bitset* b);
+
+/* the first set bit at or after i, or BITSET_NONE */
+size_t bitset_next(const bitset* b, size_t i);
+#define bitset_first(b) bitset_next((b), 0)
+
+/* 0 on success, -1 with errno set if memory runs out */
+int bitset_index(bitset* b);
+/* set bits below i */
+size_t bitset_rank(const bitset* b, size_t i);
+/* the k-th set bit counting from 0, or BITSET_NONE */
+size_t bitset_select(const bitset* b, size_t k);
+
+/* dst = dst op src, with src taken as 0 past its last bit */
+void bitset_and(bitset* dst, const bitset* src);
+void bitset_or(bitset* dst, const bitset* src);
+void bitset_xor(bitset* dst, const bitset* src);
+void bitset_andnot(bitset* dst, const bitset* src);
+
+#endif
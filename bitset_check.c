@@ -0,0 +1,203 @@
+// Checks bitset.c against a plain array of one char per bit. Sets of
+// sizes on either side of a word and of a rank block take random
+// single-bit and range changes; after each round every test, next,
+// rank and select, and counts over random ranges, must match the
+// array, and the bits past nbits must still be 0. The word-wise set
+// operations are run against sets of other sizes, smaller and larger.
+// Prints the first bad call of every function that differs and exits
+// non-zero if any does.
+// usage: bitset_check
+//   built as gcc -O2 bitset_check.c bitset.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "bitset.h"
+
+/* rounds of random changes per size */
+#define ROUNDS 40
+
+static int failures;
+
+static void fail(const char* f, size_t nbits, size_t in, size_t got,
+                 size_t want) {
+  printf("%s(%zu) on %zu bits = %zd, want %zd\n", f, in, nbits,
+         (ssize_t)got, (ssize_t)want);
+  failures++;
+}
+
+static uint32_t seed = 2463534242u;
+
+/* xorshift32, so every run sees the same inputs */
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+/* a random index below n, n > 0 */
+static size_t pick(size_t n) { return ((size_t)rnd() << 16 ^ rnd()) % n; }
+
+/* every query of b against ref, stopping at each function's first */
+/* difference */
+static void compare(bitset* b, const char* ref) {
+  size_t n = b->nbits, i, k, count = 0, next = BITSET_NONE;
+  int bad;
+  if (b->nbits & 63 && b->w[b->nwords - 1] >> (b->nbits & 63)) {
+    fail("bits past nbits", n, b->nwords - 1,
+         b->w[b->nwords - 1] >> (n & 63), 0);
+    return;
+  }
+  for (i = 0; i < n; i++)
+    if (bitset_test(b, i) != ref[i]) {
+      fail("bitset_test", n, i, bitset_test(b, i), ref[i]);
+      break;
+    }
+  for (i = n, bad = 0; i-- > 0;) {
+    if (ref[i])
+      next = i;
+    if (!bad && bitset_next(b, i) != next) {
+      fail("bitset_next", n, i, bitset_next(b, i), next);
+      bad = 1;
+    }
+  }
+  if (bitset_next(b, n) != BITSET_NONE)
+    fail("bitset_next", n, n, bitset_next(b, n), BITSET_NONE);
+  if (bitset_index(b)) {
+    fprintf(stderr, "out of memory\n");
+    exit(2);
+  }
+  for (i = 0, k = 0, bad = 0; i <= n; i++) {
+    if (!bad && bitset_rank(b, i) != count) {
+      fail("bitset_rank", n, i, bitset_rank(b, i), count);
+      bad = 1;
+    }
+    if (i < n && ref[i]) {
+      if (!bad && bitset_select(b, k) != i) {
+        fail("bitset_select", n, k, bitset_select(b, k), i);
+        bad = 1;
+      }
+      k++;
+      count++;
+    }
+  }
+  if (bitset_select(b, count) != BITSET_NONE)
+    fail("bitset_select", n, count, bitset_select(b, count), BITSET_NONE);
+  if (bitset_count(b) != count)
+    fail("bitset_count", n, 0, bitset_count(b), count);
+  for (k = 0; n && k < 64; k++) {
+    size_t lo = pick(n + 1), hi = lo + pick(n + 1 - lo), want = 0;
+    for (i = lo; i < hi; i++)
+      want += ref[i];
+    if (bitset_count_range(b, lo, hi) != want) {
+      fail("bitset_count_range", n, lo, bitset_count_range(b, lo, hi), want);
+      printf("  over [%zu, %zu)\n", lo, hi);
+      break;
+    }
+  }
+}
+
+/* a few single bits and one range, set or cleared, in b and ref */
+static void change(bitset* b, char* ref) {
+  size_t n = b->nbits, lo, hi, i;
+  int k, set = rnd() & 1;
+  for (k = 0; k < 8; k++) {
+    i = pick(n);
+    if (rnd() & 1)
+      bitset_set(b, i);
+    else
+      bitset_clear(b, i);
+    ref[i] = bitset_test(b, i);
+  }
+  /* short ranges in one word as often as long ones */
+  lo = pick(n + 1);
+  hi = lo + pick(rnd() & 1 || n - lo < 70 ? n + 1 - lo : 70);
+  if (set)
+    bitset_set_range(b, lo, hi);
+  else
+    bitset_clear_range(b, lo, hi);
+  memset(ref + lo, set, hi - lo);
+}
+
+/* dst op= src for each operation, against the same on the arrays */
+static void check_ops(bitset* dst, char* ref, size_t srcbits) {
+  static const char* name[] = {"bitset_and", "bitset_or", "bitset_xor",
+                               "bitset_andnot"};
+  bitset src;
+  char* sref = calloc(srcbits + 1, 1);
+  size_t i;
+  int op, k;
+  if (!sref || bitset_init(&src, srcbits)) {
+    fprintf(stderr, "out of memory\n");
+    exit(2);
+  }
+  for (op = 0; op < 4; op++) {
+    int before = failures;
+    for (k = 0; srcbits && k < 4; k++)
+      change(&src, sref);
+    switch (op) {
+    case 0: bitset_and(dst, &src); break;
+    case 1: bitset_or(dst, &src); break;
+    case 2: bitset_xor(dst, &src); break;
+    default: bitset_andnot(dst, &src); break;
+    }
+    for (i = 0; i < dst->nbits; i++) {
+      char s = i < srcbits && sref[i];
+      ref[i] = op == 0 ? ref[i] & s
+             : op == 1 ? ref[i] | s
+             : op == 2 ? ref[i] ^ s
+             : ref[i] & !s;
+    }
+    compare(dst, ref);
+    if (failures != before)
+      printf("  after %s with %zu bits\n", name[op], srcbits);
+  }
+  bitset_free(&src);
+  free(sref);
+}
+
+int main(void) {
+  /* either side of a word, of a rank block and of several blocks */
+  static const size_t sizes[] = {0, 1, 2, 63, 64, 65, 127, 128, 129,
+                                 511, 512, 513, 1023, 1024, 4095, 4097,
+                                 100003};
+  size_t s;
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t n = sizes[s];
+    bitset b;
+    char* ref = calloc(n + 1, 1);
+    int r;
+    if (!ref || bitset_init(&b, n)) {
+      fprintf(stderr, "out of memory\n");
+      return 2;
+    }
+    compare(&b, ref);
+    for (r = 0; r < ROUNDS && n; r++) {
+      int before = failures;
+      change(&b, ref);
+      compare(&b, ref);
+      if (failures != before)
+        break;
+    }
+    check_ops(&b, ref, n);
+    check_ops(&b, ref, n / 2);
+    check_ops(&b, ref, n + 100);
+    /* all set, then all clear, the ranges that touch every word */
+    bitset_set_range(&b, 0, n);
+    memset(ref, 1, n);
+    compare(&b, ref);
+    bitset_clear_range(&b, 0, n);
+    memset(ref, 0, n);
+    compare(&b, ref);
+    bitset_free(&b);
+    free(ref);
+  }
+  if (failures) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -3,14 +3,23 @@
 // It is capable of parsing a command line of 512 characters or less 
 // with ; | >.
 
+#define _GNU_SOURCE // pipe2, F_SETPIPE_SZ
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <spawn.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+extern char **environ;
+
+// pipes between the stages of a pipeline are grown to this many
+// bytes where the system allows, so fast stages block less often
+#define PIPE_BUFFER (1 << 20)
+
 int stdi = STDIN_FILENO;
 int stdo = STDOUT_FILENO;
 char error_message[30] = "An error has occurred\n";
@@ -34,9 +43,16 @@ struct cmd{
   cmd *next;
 }; //separates commands around redirection character '>'      
 
+typedef struct pipeline pipeline;
+struct pipeline{
+  cmd* cmd;
+  pipeline *next;
+}; //stages of a command separated by '|', in order
+
 typedef struct cmd_line cmd_line;
 struct cmd_line{
-  cmd* cmd;
+  cmd* cmd; // the first stage of pipe
+  pipeline* pipe;
   cmd_line *next;
 }; //stores individual commands (separated by ';') in a linked list
 
@@ -118,9 +134,72 @@ cmd* parseCmd(char* input) {
   return top;
 }
 
-cmd_line* cmdline_singleton(cmd* cmd) {
+pipeline* pipeline_singleton(cmd* cmd) {
+  pipeline* pl=malloc(sizeof(pipeline));
+  pl->cmd = cmd;
+  pl->next = NULL;
+  return pl;
+}
+
+// 1 if some stage of input has no command to run: a '|' with nothing
+// on one side, as in "ls | " or "a |  | b", or a part before or after
+// a '>' that is only blanks. strtok_r would skip the empty ones and
+// parseRedToken cannot take the blank ones
+int emptyStage(char* input) {
+  char prev = '|'; // the start of the line counts as a '|'
+  int len = 0, blank = 1;
+  if (!input)
+    return 1;
+  for (;; input++) {
+    if (*input == '|' || *input == '>' || !*input) {
+      if (len ? blank : (prev == '|' || *input == '|'))
+        return 1;
+      if (!*input)
+        return 0;
+      prev = *input;
+      len = 0;
+      blank = 1;
+    } else {
+      len++;
+      if (*input != ' ' && *input != '\t')
+        blank = 0;
+    }
+  }
+}
+
+// the stages of input, or NULL if one of them is empty
+pipeline* parsePipeline(char* input) {
+  pipeline *top, *pl;
+  char *pl_s,*saveptr;
+
+  if (emptyStage(input))
+    return NULL;
+  pl_s = strtok_r(input,"|",&saveptr);
+  pl = pipeline_singleton(parseCmd(pl_s));
+  top = pl;
+  while(pl_s) {
+    pl_s = strtok_r(NULL,"|",&saveptr);
+    if (pl_s==NULL)
+      break;
+    pl->next = pipeline_singleton(parseCmd(pl_s));
+    pl = pl->next;
+  }
+  return top;
+}
+
+int numStages(pipeline* pl){
+  int rv=0;
+  while (pl){
+    rv++;
+    pl = pl->next;
+  }
+  return rv;
+}
+
+cmd_line* cmdline_singleton(pipeline* pl) {
   cmd_line* cl=malloc(sizeof(cmd_line));
-  cl->cmd = cmd;
+  cl->cmd = pl ? pl->cmd : NULL;
+  cl->pipe = pl;
   cl->next = NULL;
   return cl;
 }
@@ -130,47 +209,81 @@ cmd_line* parseCmdLine(char* input) {
   char *cl_s,*saveptr;
 
   cl_s = strtok_r(input,";",&saveptr);
-  cl = cmdline_singleton(parseCmd(cl_s));
+  cl = cmdline_singleton(parsePipeline(cl_s));
   top = cl;
   while(cl_s) {
     cl_s = strtok_r(NULL,";",&saveptr);
     if (cl_s==NULL)
       break;
-    cl->next = cmdline_singleton(parseCmd(cl_s));
+    cl->next = cmdline_singleton(parsePipeline(cl_s));
     cl = cl->next;
   }
   return top;
 }
 
+// the tokens of rdt as an argv array, ending in NULL for execvp
 char **set_args(redirection_token* rdt){
-  //myPrint("where we at");
   int len = numRedTok(rdt);
-  char **rv=malloc(sizeof(char*)*len);
+  char **rv=malloc(sizeof(char*)*(len+1));
   char **top;
   top = rv;
   while(rdt){
-    //myPrint(rdt->val);
-    //*rv=strndup(rdt->val,strlen(rdt->val)-1);
     *rv = rdt->val;
-    myPrint(rdt->val);
-    //myPrint("did we crash");
-    //myPrint(*rv);
-    //myPrint("did we crash2");
     rv++;
-    //if (rdt->next == NULL)
-    //  myPrint("let me know");
     rdt=rdt->next;
   }
-  //myPrint("we outtie");
-  //myPrint(*top);
-  //sleep(1);
-  myPrint("top");
-  myPrint(top[0]);
-  myPrint("top2");
-  myPrint(top[1]);
+  *rv = NULL;
   return top;
 }
 
+// starts args[0] with its standard input on in and output on out,
+// by posix_spawnp, which does not copy the shell's page tables as
+// fork does. fork is only tried when the spawn itself fails for lack
+// of resources or support, or always when built with -DLAUNCH_FORK,
+// to compare the two. Returns the child's pid, or -1 if it could
+// not be run
+pid_t launch(char **args, int in, int out) {
+  pid_t pid;
+#ifndef LAUNCH_FORK
+  posix_spawn_file_actions_t fa;
+  int err;
+
+  posix_spawn_file_actions_init(&fa);
+  if (in != STDIN_FILENO) {
+    posix_spawn_file_actions_adddup2(&fa, in, STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&fa, in);
+  }
+  if (out != STDOUT_FILENO) {
+    posix_spawn_file_actions_adddup2(&fa, out, STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&fa, out);
+  }
+  err = posix_spawnp(&pid, args[0], &fa, NULL, args, environ);
+  posix_spawn_file_actions_destroy(&fa);
+  if (!err)
+    return pid;
+  if (err != EAGAIN && err != ENOMEM && err != ENOSYS) {
+    write(stdo, error_message, strlen(error_message));
+    return -1;
+  }
+#endif
+  if (!(pid = fork())) { // 0 for child process
+    if (in != STDIN_FILENO) {
+      dup2(in, STDIN_FILENO);
+      close(in);
+    }
+    if (out != STDOUT_FILENO) {
+      dup2(out, STDOUT_FILENO);
+      close(out);
+    }
+    execvp(*args, args);
+    write(STDOUT_FILENO, error_message, strlen(error_message));
+    _exit(1);
+  }
+  if (pid < 0)
+    write(stdo, error_message, strlen(error_message));
+  return pid;
+}
+
 void myPWD(char *rv) {
   getcwd(rv,512);
   return;
@@ -215,110 +328,145 @@ void freeRedToken(redirection_token* rt) {
 void freeCmd(cmd* cmd) {
   freeRedToken(cmd->rdt);
   if (cmd->next)
-    free(cmd->next);
+    freeCmd(cmd->next);
   free(cmd);
 }
 
+// frees cl and every command line after it
 void freeCmdLine(cmd_line* cl) {
-  freeCmd(cl->cmd);
-  if (cl->next)
-    free(cl->next);
-  free(cl);
+  pipeline *pl, *next;
+  cmd_line *nextcl;
+  while (cl) {
+    for (pl = cl->pipe; pl; pl = next) {
+      next = pl->next;
+      freeCmd(pl->cmd);
+      free(pl);
+    }
+    nextcl = cl->next;
+    free(cl);
+    cl = nextcl;
+  }
 }
 
 void exe(cmd* cmd){
   // myPrint(cmd->rdt->val);
   // myPrint(cmd->rdt->next->val);
-  int f;
-  char *p,*c,*e;
+  int f = -1;
+  const char *p="pwd",*c="cd",*e="exit";
   // char buf[4];
   // sprintf(buf,"%d",redirect(cmd));
   // myPrint(buf);
   //    char * hello= (char*)malloc(sizeof(cmd->rdt->val));
   //    sprintf(buf, "%d", (int)strlen(cmd->rdt->val));
   //myPrint(buf);
-  char *lo=malloc(sizeof(char)*(strlen(cmd->rdt->val)+1));
-  lo=cmd->rdt->val;
+  char *lo=cmd->rdt->val;
   //myPrint("lo");
   //myPrint(lo);
-  p=strdup("pwd");
-  c=strdup("cd");
-  e=strdup("exit");
   if (redirect(cmd)==2){
     //myPrint("redirect");
     
-    if(numRedTok(cmd->rdt) != 1){
-        char duf[4];
-        sprintf(duf,"%d",numRedTok(cmd->rdt->next));
-        myPrint(duf);
-      //myPrint("branch 1");
+    if(numRedTok(cmd->next->rdt) != 1){ // exactly one file after '>'
       write(stdo, error_message, strlen(error_message));
-      return;
+      goto done;
     }
-    //myPrint("open");
-    //int f = open(cmd->next->rdt->val, O_RDWR | O_CREAT, S_IWUSR | S_IWGRP | S_IWOTH);
-    
-    //myPrint("open1.2");
-    // myPrint(cmd->rdt->val);
-    // myPrint(cmd->rdt->next->val);
-    if ((f = open(cmd->next->rdt->val, O_RDWR | O_APPEND | S_IRUSR)) == -1) {
-      //myPrint("open1.5");
-      f = creat(cmd->next->rdt->val, O_RDWR | S_IRUSR);
+    // appended to if it exists; the child gets it as its stdout
+    f = open(cmd->next->rdt->val, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (f == -1) {
+      write(stdo, error_message, strlen(error_message));
+      goto done;
     }
-    //myPrint("open2");
-    // char euf[4];
-    // sprintf(euf,"%d",f);
-    // myPrint(euf);
     stdo = f;
-    //dup2(f,1);
-    // close(1);
-    // dup(f);
-    //myPrint("open3");
   } else if (redirect(cmd) >2){
     //myPrint("branch 2");
     write(stdo, error_message, strlen(error_message));
-    return;
+    goto done;
   }
   if(!strncmp(lo, p,3 )){
     char pwd[512];
     myPWD(pwd);
     write(stdo, pwd, strlen(pwd));
-    return;
+    goto done;
   }
   if(!strncmp(lo,c,2)){
     char* path=cmd->rdt->next->val;
     myCD(path);
-    return;
+    goto done;
   }
   if(!strncmp(lo,e,4))
     exit(0);
   pid_t pid;
   int status;
   char **args=set_args(cmd->rdt);
-  //myPrint(args[0]);
-  //myPrint(args[1]);
-  //myPrint(args[2]);
-  //myPrint(args[3]);
-  myPrint("   b4 fork  ");
-  myPrint(*args);
-  myPrint(args[0]);
-  myPrint(args[1]);
-  myPrint(args[2]);
-  if (!(pid = fork())){ // 0 for child process
-    if (execvp(*args,args)<0){
-      myPrint("   after fork  ");
+  if ((pid = launch(args, STDIN_FILENO, stdo)) > 0)
+    waitpid(pid, &status, 0);
+  free(args);
+ done: // every way out puts the shell's stdout back
+  if (stdo != STDOUT_FILENO)
+    close(stdo);
+  stdo = STDOUT_FILENO;
+}
+
+// runs every stage of pl at once, each reading the one before it
+// through a pipe, and returns once all of them have exited. Only
+// the last stage may redirect its output with '>'
+void runPipeline(pipeline* pl){
+  int n = numStages(pl), i, status;
+  pid_t *pids = malloc(sizeof(pid_t)*n);
+  int in = STDIN_FILENO, out, fds[2];
+  pipeline *st;
+
+  for (st = pl, i = 0; st; st = st->next, i++) {
+    int bad = redirect(st->cmd) > 2 || (redirect(st->cmd) == 2
+              && (st->next || numRedTok(st->cmd->next->rdt) != 1));
+    fds[0] = -1;
+    out = STDOUT_FILENO;
+    pids[i] = -1;
+    if (st->next) {
+      if (pipe2(fds, O_CLOEXEC) == -1) {
+        write(stdo, error_message, strlen(error_message));
+        break;
+      }
+#ifdef F_SETPIPE_SZ
+      fcntl(fds[1], F_SETPIPE_SZ, PIPE_BUFFER); // a smaller pipe will do
+#endif
+      out = fds[1];
+    } else if (!bad && redirect(st->cmd) == 2) {
+      out = open(st->cmd->next->rdt->val,
+                 O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+      bad = out == -1;
+      if (bad)
+        out = STDOUT_FILENO;
+    }
+    // a stage that cannot run closes its pipe, so the next reads EOF
+    if (bad) {
       write(stdo, error_message, strlen(error_message));
+    } else {
+      char **args = set_args(st->cmd->rdt);
+      pids[i] = launch(args, in, out);
+      free(args);
     }
-    // stdo = 1;
-    // dup2(f, 1);
-    // close(f);
-  } else
-    while (wait(&status) != pid);
-  stdo = 1;
-  dup2(f, 1);
-  close(f);
-  // close(stdo);
-  // dup(stdo);
+    if (in != STDIN_FILENO)
+      close(in);
+    if (out != STDOUT_FILENO)
+      close(out);
+    in = fds[0];
+  }
+  if (in != STDIN_FILENO && in != -1)
+    close(in);
+  while (i--)
+    if (pids[i] > 0)
+      waitpid(pids[i], &status, 0);
+  free(pids);
+}
+
+// runs one ';'-separated command, as a pipeline if it has a '|'
+void runCmdLine(cmd_line* cl){
+  if (!cl->pipe) // an empty stage
+    write(stdo, error_message, strlen(error_message));
+  else if (cl->pipe->next)
+    runPipeline(cl->pipe);
+  else
+    exe(cl->cmd);
 }
 
 int main(int argc, char *argv[])
@@ -327,21 +475,40 @@ int main(int argc, char *argv[])
   char cmd_buff[514]; //shouldn't this be 514?
   char *pinput;
 
-  // batch mode
+  // batch mode: the file is read a line at a time, and each line is
+  // echoed before it runs
   if (argc == 2) {
+    FILE *batch = fopen(argv[1], "r");
+    cmd_line *cl, *c;
 
-    int batch = open(argv[1], O_RDONLY); // open file to read only
-    // if fscanf > 514, we print but not use
-    stdi=batch;
-    while (read(stdi,cmd_buff,514)){
+    if (!batch) {
+      write(stdo, error_message, strlen(error_message));
+      exit(1);
+    }
+    while (fgets(cmd_buff, sizeof(cmd_buff), batch)) {
+      if (stdo != STDOUT_FILENO)
+        close(stdo);
+      stdo = STDOUT_FILENO;
       myPrint(cmd_buff);
-      cmd_line* cl=parseCmdLine(cmd_buff);
-      while(cl->cmd){
-  exe(cl->cmd);
-  cl=cl->next;
+      if (!strchr(cmd_buff, '\n') && !feof(batch)) {
+        // longer than 512 characters: echo the rest, run none of it
+        while (fgets(cmd_buff, sizeof(cmd_buff), batch)) {
+          myPrint(cmd_buff);
+          if (strchr(cmd_buff, '\n'))
+            break;
+        }
+        write(stdo, error_message, strlen(error_message));
+        continue;
       }
+      cmd_buff[strcspn(cmd_buff, "\n")] = 0;
+      if (!cmd_buff[strspn(cmd_buff, " \t")]) // nothing to run
+        continue;
+      cl = parseCmdLine(cmd_buff);
+      for (c = cl; c; c = c->next)
+        runCmdLine(c);
       freeCmdLine(cl);
     }
+    fclose(batch);
     // after we reach the end of file
     exit(1);
   }
@@ -360,24 +527,18 @@ int main(int argc, char *argv[])
     // dup2(1,1);
     myPrint("myshell> ");
     pinput = fgets(cmd_buff, 514, stdin);
-    pinput = strndup(pinput, strlen(pinput)-1);
-    cmd_line* cls=parseCmdLine(pinput);
-    // printf("%s\n", cls->cmd->rdt->val);
-    // printf("%s\n", cls->cmd->rdt->next->val);
-    while(cls->cmd){
-      exe(cls->cmd);
-      //      myPrint("that");
-      if(cls->next)
-  cls=cls->next;
-      else{
-  myPrint("\n");
-  cls->cmd = NULL;
-      }    
-    }
-
-       //freeCmdLine(cls);
     if (!pinput) {
       exit(0);
     }
+    cmd_buff[strcspn(cmd_buff, "\n")] = 0;
+    if (!cmd_buff[strspn(cmd_buff, " \t")]) // nothing to run
+      continue;
+    cmd_line *cls=parseCmdLine(cmd_buff), *c;
+    // printf("%s\n", cls->cmd->rdt->val);
+    // printf("%s\n", cls->cmd->rdt->next->val);
+    for (c = cls; c; c = c->next)
+      runCmdLine(c);
+    myPrint("\n");
+    freeCmdLine(cls);
   }
 }
@@ -0,0 +1,97 @@
+// Commands per second through myshell's batch mode. A batch file of
+// the given number of lines is written once per case and run by each
+// shell named on the command line, with its output thrown away, so
+// two builds can be compared: myshell as it is (posix_spawnp) and one
+// built with -DLAUNCH_FORK. Prints one CSV line per shell and case:
+//   shell,case,commands,seconds,commands_per_s
+// usage: myshell_bench lines shell...
+//   e.g. gcc -O2 -o myshell myshell.c
+//        gcc -O2 -DLAUNCH_FORK -o myshell_fork myshell.c
+//        myshell_bench 10000 ./myshell ./myshell_fork
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a batch file of lines copies of line, or NULL
+static char *write_batch(const char *line, long lines) {
+  char *path = strdup("/tmp/myshell_benchXXXXXX");
+  int fd = mkstemp(path);
+  FILE *f = fd < 0 ? NULL : fdopen(fd, "w");
+  long i;
+  if (!f) {
+    free(path);
+    return NULL;
+  }
+  for (i = 0; i < lines; i++)
+    fprintf(f, "%s\n", line);
+  fclose(f);
+  return path;
+}
+
+// seconds for shell to run every line of batch, or -1
+static double run(const char *shell, const char *batch) {
+  double t0 = now();
+  int status;
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execl(shell, shell, batch, (char *)NULL);
+    _exit(127);
+  }
+  if (pid < 0 || waitpid(pid, &status, 0) < 0)
+    return -1;
+  // batch mode exits 1 at the end of the file
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+    return -1;
+  return now() - t0;
+}
+
+int main(int argc, char *argv[]) {
+  // one command, and two commands joined by a pipe
+  static const char *cases[][2] = {
+    {"simple", "true"},
+    {"pipeline", "true | true"},
+  };
+  long lines = argc > 2 ? atol(argv[1]) : 0;
+  int i, j, rv = 0;
+  if (lines <= 0) {
+    fprintf(stderr, "usage: %s lines shell...\n", argv[0]);
+    return 1;
+  }
+  printf("shell,case,commands,seconds,commands_per_s\n");
+  for (i = 0; i < 2; i++) {
+    char *batch = write_batch(cases[i][1], lines);
+    if (!batch) {
+      fprintf(stderr, "cannot write a batch file\n");
+      return 1;
+    }
+    for (j = 2; j < argc; j++) {
+      double secs = run(argv[j], batch);
+      if (secs < 0) {
+        fprintf(stderr, "%s did not run %s\n", argv[j], batch);
+        rv = 1;
+        continue;
+      }
+      printf("%s,%s,%ld,%.3f,%.0f\n", argv[j], cases[i][0], lines, secs,
+             lines / secs);
+      fflush(stdout);
+    }
+    unlink(batch);
+    free(batch);
+  }
+  return rv;
+}